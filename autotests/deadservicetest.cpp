@@ -13,6 +13,8 @@
 #include <QProcess>
 #include <QTest>
 
+#include <kdbustestbus.h>
+
 #include <signal.h>
 #include <unistd.h>
 
@@ -23,7 +25,20 @@ class TestObject : public QObject
     Q_OBJECT
 
     QList<int> m_danglingPids;
+    KDBusTestBus m_bus;
+    QDBusConnection m_connection = QDBusConnection(QString());
+
 private Q_SLOTS:
+    void initTestCase()
+    {
+        // Run against a private bus rather than whatever session bus the machine provides
+        if (!m_bus.start()) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+        m_connection = m_bus.connection(QStringLiteral("test"));
+        QVERIFY(m_connection.isConnected());
+    }
+
     void cleanupTestCase()
     {
         // Make sure we don't leave dangling processes even when we had an
@@ -35,10 +50,11 @@ private Q_SLOTS:
 
     void testDeadService()
     {
-        QVERIFY(!QDBusConnection::sessionBus().interface()->isServiceRegistered(s_serviceName).value());
+        QVERIFY(!m_connection.interface()->isServiceRegistered(s_serviceName).value());
 
         QProcess proc1;
         proc1.setProgram(QFINDTESTDATA("kdbussimpleservice"));
+        proc1.setProcessEnvironment(m_bus.processEnvironment());
         proc1.setProcessChannelMode(QProcess::ForwardedChannels);
         proc1.start();
         QVERIFY(proc1.waitForStarted());
@@ -52,7 +68,7 @@ private Q_SLOTS:
         bool proc1Registered = QTest::qWaitFor(
             [&]() {
                 QTest::qSleep(1000);
-                return QDBusConnection::sessionBus().interface()->servicePid(s_serviceName).value() == pid1;
+                return m_connection.interface()->servicePid(s_serviceName).value() == pid1;
             },
             8000);
         QVERIFY(proc1Registered);
@@ -64,7 +80,7 @@ private Q_SLOTS:
         // start second instance
         QProcess proc2;
         proc2.setProgram(QFINDTESTDATA("kdbussimpleservice"));
-        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        QProcessEnvironment env = m_bus.processEnvironment();
         env.insert("KCRASH_AUTO_RESTARTED", "1");
         proc2.setProcessEnvironment(env);
         proc2.setProcessChannelMode(QProcess::ForwardedChannels);
@@ -90,7 +106,7 @@ private Q_SLOTS:
         bool proc2Registered = QTest::qWaitFor(
             [&]() {
                 QTest::qSleep(1000);
-                return QDBusConnection::sessionBus().interface()->servicePid(s_serviceName).value() == pid2;
+                return m_connection.interface()->servicePid(s_serviceName).value() == pid2;
             },
             8000);
         QVERIFY(proc2Registered);
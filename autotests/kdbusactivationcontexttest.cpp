@@ -0,0 +1,54 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QTest>
+
+#include <kdbusactivationcontext.h>
+
+class KDBusActivationContextTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testEmpty()
+    {
+        const KDBusActivationContext context;
+        QVERIFY(!context.isValid());
+        QVERIFY(context.activationToken().isEmpty());
+        QVERIFY(context.desktopStartupId().isEmpty());
+        QVERIFY(context.platformData().isEmpty());
+    }
+
+    void testPlatformData()
+    {
+        QVariantMap platformData;
+        platformData.insert(QStringLiteral("activation-token"), QStringLiteral("token_1234"));
+        platformData.insert(QStringLiteral("desktop-startup-id"), QByteArray("startup_5678"));
+        platformData.insert(QStringLiteral("something-else"), 42);
+
+        const KDBusActivationContext context(platformData);
+        QVERIFY(context.isValid());
+        QCOMPARE(context.activationToken(), QByteArray("token_1234"));
+        QCOMPARE(context.desktopStartupId(), QByteArray("startup_5678"));
+        QCOMPARE(context.platformData(), platformData);
+
+        const KDBusActivationContext copy = context;
+        QCOMPARE(copy.activationToken(), context.activationToken());
+    }
+
+    void testNoToken()
+    {
+        const KDBusActivationContext context{QVariantMap()};
+        QVERIFY(context.isValid());
+        QVERIFY(context.activationToken().isEmpty());
+    }
+};
+
+QTEST_GUILESS_MAIN(KDBusActivationContextTest)
+
+#include "kdbusactivationcontexttest.moc"
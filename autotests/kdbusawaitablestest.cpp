@@ -0,0 +1,144 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QTest>
+#include <QTimer>
+
+#include <kdbusawaitables.h>
+#include <kdbustestbus.h>
+
+#include <exception>
+
+static const QString s_serviceName = QStringLiteral("org.kde.kdbusawaitablestest");
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+// The smallest coroutine type: starts right away and nobody waits for it
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object()
+        {
+            return {};
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void()
+        {
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+struct Results {
+    KLaunchEnvironmentState::Backends backends;
+    QDBusError quitError;
+    QDBusMessage pingReply;
+    bool done = false;
+};
+
+// Chains the operations of a session startup, each one after the other
+static DetachedTask startSession(QProcessEnvironment environment, QDBusConnection connection, Results *results)
+{
+    results->backends = co_await KDBusAddons::updateLaunchEnvironment(environment);
+    results->quitError = co_await KDBusAddons::quitService(s_serviceName, connection);
+
+    const QDBusMessage ping = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                             QStringLiteral("/org/freedesktop/DBus"),
+                                                             QStringLiteral("org.freedesktop.DBus.Peer"),
+                                                             QStringLiteral("Ping"));
+    results->pingReply = co_await KDBusAddons::call(connection.asyncCall(ping));
+    results->done = true;
+}
+#endif
+
+// Stands in for the application that is asked to quit
+class QuitObject : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.KDBusAwaitablesTest")
+
+public:
+    explicit QuitObject(const QDBusConnection &connection)
+        : m_connection(connection)
+    {
+    }
+
+public Q_SLOTS:
+    Q_SCRIPTABLE void quit()
+    {
+        QTimer::singleShot(0, this, [this]() {
+            m_connection.unregisterService(s_serviceName);
+        });
+    }
+
+private:
+    QDBusConnection m_connection;
+};
+
+class KDBusAwaitablesTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+#if !defined(__cpp_impl_coroutine) || !__has_include(<coroutine>)
+        QSKIP("The compiler does not support coroutines");
+#endif
+        if (!m_bus.start(KDBusTestBus::AllStubs)) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+        // KUpdateLaunchEnvironmentJob always talks to the session bus
+        m_bus.exportAsSessionBus();
+    }
+
+    void testChain()
+    {
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+        QDBusConnection service = m_bus.connection(QStringLiteral("service"));
+        QuitObject object(service);
+        QVERIFY(service.registerObject(QStringLiteral("/MainApplication"), &object, QDBusConnection::ExportScriptableSlots));
+        QVERIFY(service.registerService(s_serviceName));
+
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KDBUSAWAITABLESTEST_VAR"), QStringLiteral("value"));
+        QDBusConnection client = m_bus.connection(QStringLiteral("client"));
+
+        Results results;
+        startSession(environment, client, &results);
+        // Nothing finishes before the event loop runs
+        QVERIFY(!results.done);
+        QTRY_VERIFY_WITH_TIMEOUT(results.done, 10000);
+
+        QCOMPARE(results.backends, KLaunchEnvironmentState::AllBackends);
+        QCOMPARE(m_bus.startupEnvironment().value(QStringLiteral("KDBUSAWAITABLESTEST_VAR")), QStringLiteral("value"));
+        QVERIFY2(!results.quitError.isValid(), qPrintable(results.quitError.message()));
+        QVERIFY(!client.interface()->isServiceRegistered(s_serviceName).value());
+        QCOMPARE(results.pingReply.type(), QDBusMessage::ReplyMessage);
+
+        service.unregisterObject(QStringLiteral("/MainApplication"));
+#endif
+    }
+
+private:
+    KDBusTestBus m_bus;
+};
+
+QTEST_GUILESS_MAIN(KDBusAwaitablesTest)
+
+#include "kdbusawaitablestest.moc"
@@ -0,0 +1,103 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QSignalSpy>
+#include <QTest>
+
+#include <kdbusinstancewatcher.h>
+#include <kdbustestbus.h>
+
+class KDBusInstanceWatcherTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        if (!m_bus.start()) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+    }
+
+    void testIsInstance()
+    {
+        KDBusInstanceWatcher watcher(QStringLiteral("org.kde.watchertest"), QDBusConnection(QStringLiteral("none")));
+        QVERIFY(watcher.isInstance(QStringLiteral("org.kde.watchertest")));
+        QVERIFY(watcher.isInstance(QStringLiteral("org.kde.watchertest-1234")));
+        QVERIFY(watcher.isInstance(QStringLiteral("org.kde.watchertest.kdbus-1_42")));
+        QVERIFY(watcher.isInstance(QStringLiteral("org.kde.watchertest.shard-3")));
+        QVERIFY(!watcher.isInstance(QStringLiteral("org.kde.watchertest-")));
+        QVERIFY(!watcher.isInstance(QStringLiteral("org.kde.watchertest-abc")));
+        QVERIFY(!watcher.isInstance(QStringLiteral("org.kde.watchertestother")));
+        QVERIFY(!watcher.isInstance(QStringLiteral("org.kde.watchertest.Helper")));
+    }
+
+    void testWatch()
+    {
+        QDBusConnection instances = m_bus.connection(QStringLiteral("instances"));
+        QVERIFY(instances.isConnected());
+        QVERIFY(instances.registerService(QStringLiteral("org.kde.watchertest-100")));
+        QVERIFY(instances.registerService(QStringLiteral("org.kde.watchertestother-100")));
+
+        QDBusConnection connection = m_bus.connection(QStringLiteral("watcher"));
+        KDBusInstanceWatcher watcher(QStringLiteral("org.kde.watchertest"), connection);
+        QCOMPARE(watcher.instances(), QStringList{QStringLiteral("org.kde.watchertest-100")});
+
+        QSignalSpy addedSpy(&watcher, &KDBusInstanceWatcher::instanceAdded);
+        QSignalSpy removedSpy(&watcher, &KDBusInstanceWatcher::instanceRemoved);
+
+        QVERIFY(instances.registerService(QStringLiteral("org.kde.watchertestother-200")));
+        QVERIFY(instances.registerService(QStringLiteral("org.kde.watchertest-200")));
+        QVERIFY(addedSpy.wait());
+        QCOMPARE(addedSpy.count(), 1);
+        QCOMPARE(addedSpy.at(0).at(0).toString(), QStringLiteral("org.kde.watchertest-200"));
+        QCOMPARE(watcher.instances(), (QStringList{QStringLiteral("org.kde.watchertest-100"), QStringLiteral("org.kde.watchertest-200")}));
+
+        QVERIFY(instances.unregisterService(QStringLiteral("org.kde.watchertest-100")));
+        QVERIFY(removedSpy.wait());
+        QCOMPARE(removedSpy.at(0).at(0).toString(), QStringLiteral("org.kde.watchertest-100"));
+        QCOMPARE(watcher.instances(), QStringList{QStringLiteral("org.kde.watchertest-200")});
+    }
+
+    void testUnrelatedNames()
+    {
+        QDBusConnection others = m_bus.connection(QStringLiteral("others"));
+        QVERIFY(others.isConnected());
+
+        KDBusInstanceWatcher watcher(QStringLiteral("org.kde.watchertest"), m_bus.connection(QStringLiteral("watcher")));
+        QSignalSpy addedSpy(&watcher, &KDBusInstanceWatcher::instanceAdded);
+        QSignalSpy removedSpy(&watcher, &KDBusInstanceWatcher::instanceRemoved);
+
+        // Other applications in the watched namespace come and go
+        QVERIFY(others.registerService(QStringLiteral("org.kde.foo")));
+        QVERIFY(others.registerService(QStringLiteral("org.kde.watchertest.Helper")));
+        QVERIFY(others.unregisterService(QStringLiteral("org.kde.foo")));
+        QVERIFY(others.unregisterService(QStringLiteral("org.kde.watchertest.Helper")));
+
+        // The bus keeps the order, so once this instance is reported, the names above were seen
+        QVERIFY(others.registerService(QStringLiteral("org.kde.watchertest-300")));
+        QVERIFY(addedSpy.wait());
+        QCOMPARE(addedSpy.count(), 1);
+        QCOMPARE(addedSpy.at(0).at(0).toString(), QStringLiteral("org.kde.watchertest-300"));
+        QCOMPARE(removedSpy.count(), 0);
+        QVERIFY(!watcher.instances().contains(QStringLiteral("org.kde.foo")));
+
+        QVERIFY(others.unregisterService(QStringLiteral("org.kde.watchertest-300")));
+        QVERIFY(removedSpy.wait());
+        QCOMPARE(removedSpy.count(), 1);
+    }
+
+private:
+    KDBusTestBus m_bus;
+};
+
+QTEST_GUILESS_MAIN(KDBusInstanceWatcherTest)
+
+#include "kdbusinstancewatchertest.moc"
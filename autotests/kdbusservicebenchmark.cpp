@@ -0,0 +1,92 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <QTest>
+
+#include <kdbusservice.h>
+#include <kdbustestbus.h>
+
+// Measures the round-trip of calls to the interfaces of KDBusService on a private dbus-daemon
+class KDBusServiceBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QCoreApplication::setApplicationName(QStringLiteral("kdbusservicebenchmark"));
+        QCoreApplication::setOrganizationDomain(QStringLiteral("kde.org"));
+
+        if (!m_bus.start()) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QVERIFY(connection.isConnected());
+        m_service = new KDBusService(KDBusService::Unique | KDBusService::NoExitOnFailure, connection, this);
+        QVERIFY(m_service->isRegistered());
+
+        m_client = m_bus.connection(QStringLiteral("client"));
+        QVERIFY(m_client.isConnected());
+    }
+
+    void cleanupTestCase()
+    {
+        delete m_service;
+        m_client = QDBusConnection(QString());
+    }
+
+    void benchmarkActivate()
+    {
+        QDBusMessage message = createCall(QStringLiteral("org.freedesktop.Application"), QStringLiteral("Activate"));
+        message << QVariantMap();
+        QBENCHMARK {
+            // The service lives on this thread, so the call has to process events while it waits
+            const QDBusMessage reply = m_client.call(message, QDBus::BlockWithGui);
+            QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+        }
+    }
+
+    void benchmarkCommandLine()
+    {
+        QDBusMessage message = createCall(QStringLiteral("org.kde.KDBusService"), QStringLiteral("CommandLine"));
+        message << QStringList{QStringLiteral("kdbusservicebenchmark"), QStringLiteral("--option"), QStringLiteral("file.txt")} //
+                << QStringLiteral("/tmp") << QVariantMap();
+        QBENCHMARK {
+            const QDBusMessage reply = m_client.call(message, QDBus::BlockWithGui);
+            QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+        }
+    }
+
+    void benchmarkGetProperty()
+    {
+        QDBusMessage message = createCall(QStringLiteral("org.freedesktop.DBus.Properties"), QStringLiteral("Get"));
+        message << QStringLiteral("org.kde.KDBusService") << QStringLiteral("Busy");
+        QBENCHMARK {
+            const QDBusMessage reply = m_client.call(message, QDBus::BlockWithGui);
+            QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+        }
+    }
+
+private:
+    QDBusMessage createCall(const QString &interface, const QString &method) const
+    {
+        return QDBusMessage::createMethodCall(m_service->serviceName(), QStringLiteral("/org/kde/kdbusservicebenchmark"), interface, method);
+    }
+
+    KDBusTestBus m_bus;
+    KDBusService *m_service = nullptr;
+    QDBusConnection m_client = QDBusConnection(QString());
+};
+
+QTEST_GUILESS_MAIN(KDBusServiceBenchmark)
+
+#include "kdbusservicebenchmark.moc"
@@ -0,0 +1,366 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusReply>
+#include <QDBusUnixFileDescriptor>
+#include <QDBusVirtualObject>
+#include <QFile>
+#include <QProcess>
+#include <QSignalSpy>
+#include <QTest>
+#include <QThread>
+
+#include <kdbusservice.h>
+#include <kdbustestbus.h>
+#include <kdedmodule.h>
+
+#include <memory>
+
+#include <unistd.h>
+
+class TestModule : public KDEDModule
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.TestModule")
+
+public:
+    using KDEDModule::KDEDModule;
+};
+
+// Stands in for a running shard: reports its load and refuses the arguments handed over to it
+class ShardStub : public QDBusVirtualObject
+{
+    Q_OBJECT
+
+public:
+    QString introspect(const QString &) const override
+    {
+        return QString();
+    }
+
+    bool handleMessage(const QDBusMessage &message, const QDBusConnection &connection) override
+    {
+        if (message.interface() == QLatin1String("org.freedesktop.DBus.Properties")) {
+            const QVariantMap properties{
+                {QStringLiteral("Busy"), bool(busy.loadRelaxed())},
+                {QStringLiteral("PendingActivations"), 0u},
+            };
+            if (message.member() == QLatin1String("GetAll")) {
+                return connection.send(message.createReply(QVariant(properties)));
+            }
+            const QString name = message.arguments().value(1).toString();
+            return connection.send(message.createReply(QVariant::fromValue(QDBusVariant(properties.value(name)))));
+        }
+        forwarded.ref();
+        return connection.send(message.createErrorReply(QDBusError::Failed, QStringLiteral("Not taking arguments")));
+    }
+
+    QAtomicInt busy;
+    QAtomicInt forwarded;
+};
+
+// Runs KDBusService and KDEDModule on a private dbus-daemon instead of the session bus
+class KDBusServiceConnectionTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        QCoreApplication::setApplicationName(QStringLiteral("kdbusserviceconnectiontest"));
+        QCoreApplication::setOrganizationDomain(QStringLiteral("kde.org"));
+
+        if (!m_bus.start()) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+    }
+
+    void testService()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QVERIFY(connection.isConnected());
+
+        KDBusService service(KDBusService::Unique | KDBusService::NoExitOnFailure, connection);
+        QVERIFY(service.isRegistered());
+        QCOMPARE(service.serviceName(), QStringLiteral("org.kde.kdbusserviceconnectiontest"));
+        QCOMPARE(service.connection().name(), connection.name());
+        QVERIFY(connection.interface()->isServiceRegistered(service.serviceName()).value());
+
+        // Activate through a second connection to the private bus
+        QDBusConnection client = m_bus.connection(QStringLiteral("client"));
+        QVERIFY(client.isConnected());
+
+        QSignalSpy spy(&service, &KDBusService::openRequested);
+        QDBusMessage message = QDBusMessage::createMethodCall(service.serviceName(),
+                                                              QStringLiteral("/org/kde/kdbusserviceconnectiontest"),
+                                                              QStringLiteral("org.freedesktop.Application"),
+                                                              QStringLiteral("Open"));
+        message << QStringList{QStringLiteral("file:///tmp/test.txt")} << QVariantMap();
+        client.asyncCall(message);
+        QVERIFY(spy.wait());
+        QCOMPARE(spy.at(0).at(0).value<QList<QUrl>>(), QList<QUrl>{QUrl(QStringLiteral("file:///tmp/test.txt"))});
+
+        service.unregister();
+        QTRY_VERIFY(!client.interface()->isServiceRegistered(service.serviceName()).value());
+    }
+
+    void testHandover()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        KDBusService service(KDBusService::Unique | KDBusService::NoExitOnFailure, connection);
+        QVERIFY(service.isRegistered());
+        connect(&service, &KDBusService::handoverRequested, this, [](QByteArray *state) {
+            *state = QByteArrayLiteral("open documents");
+        });
+
+        QDBusConnection replacement = m_bus.connection(QStringLiteral("replacement"));
+        QVERIFY(replacement.isConnected());
+        const QDBusMessage message = QDBusMessage::createMethodCall(service.serviceName(),
+                                                                    QStringLiteral("/org/kde/kdbusserviceconnectiontest"),
+                                                                    QStringLiteral("org.kde.KDBusService"),
+                                                                    QStringLiteral("Handover"));
+
+        // Only a connection waiting for the name may take it over
+        QDBusReply<QDBusUnixFileDescriptor> reply = replacement.call(message, QDBus::BlockWithGui);
+        QCOMPARE(reply.error().type(), QDBusError::AccessDenied);
+        QCoreApplication::processEvents();
+        QCOMPARE(connection.interface()->serviceOwner(service.serviceName()).value(), connection.baseService());
+
+        QCOMPARE(replacement.interface()->registerService(service.serviceName(), QDBusConnectionInterface::QueueService).value(),
+                 QDBusConnectionInterface::ServiceQueued);
+        reply = replacement.call(message, QDBus::BlockWithGui);
+        QVERIFY2(reply.isValid(), qPrintable(reply.error().message()));
+
+        QFile state;
+        const int descriptor = reply.value().fileDescriptor();
+        QCOMPARE(lseek(descriptor, 0, SEEK_SET), 0);
+        QVERIFY(state.open(descriptor, QIODevice::ReadOnly));
+        QCOMPARE(state.readAll(), QByteArrayLiteral("open documents"));
+
+        // The name passes on to the queued connection
+        QTRY_COMPARE(replacement.interface()->serviceOwner(service.serviceName()).value(), replacement.baseService());
+        replacement.interface()->unregisterService(service.serviceName());
+    }
+
+    void testCommandLineFd()
+    {
+        // Run as the helper application, so it finds us as its running instance
+        QCoreApplication::setApplicationName(QStringLiteral("kdbussimpleservice"));
+        KDBusService service(KDBusService::Unique | KDBusService::NoExitOnFailure, m_bus.connection(QStringLiteral("service")));
+        QCoreApplication::setApplicationName(QStringLiteral("kdbusserviceconnectiontest"));
+        QVERIFY(service.isRegistered());
+        QCOMPARE(service.serviceName(), QStringLiteral("org.kde.kdbussimpleservice"));
+
+        QStringList received;
+        connect(&service, &KDBusService::activateRequested, this, [&service, &received](const QStringList &arguments) {
+            received = arguments;
+            service.setExitValue(42);
+        });
+
+        // Every argument list is bigger than the threshold, so it is handed over in a memfd
+        QProcessEnvironment environment = m_bus.processEnvironment();
+        environment.insert(QStringLiteral("KDBUSADDONS_FD_PASSING_THRESHOLD"), QStringLiteral("1"));
+        const QStringList arguments{QStringLiteral("--first"), QStringLiteral("second argument"), QString::fromUtf8("dritte \xc3\xa4")};
+        QProcess process;
+        process.setProgram(QFINDTESTDATA("kdbussimpleservice"));
+        process.setArguments(arguments);
+        process.setProcessEnvironment(environment);
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+        process.start();
+        QVERIFY(process.waitForStarted());
+
+        QTRY_COMPARE_WITH_TIMEOUT(process.state(), QProcess::NotRunning, 10000);
+        QCOMPARE(process.exitStatus(), QProcess::NormalExit);
+        QCOMPARE(process.exitCode(), 42);
+        QCOMPARE(received.mid(1), arguments);
+
+        const QList<KDBusService::ActivationLatency> latencies = service.activationLatencies();
+        QCOMPARE(latencies.size(), 1);
+        QCOMPARE(latencies.first().method, QStringLiteral("CommandLineFd"));
+
+        service.unregister();
+    }
+
+    void testBusActivation()
+    {
+        // Started the way the bus daemon starts a service, and pacing all later activations
+        QProcessEnvironment environment = m_bus.processEnvironment();
+        environment.insert(QStringLiteral("DBUS_STARTER_BUS_TYPE"), QStringLiteral("session"));
+        environment.insert(QStringLiteral("DBUS_STARTER_ADDRESS"), m_bus.address());
+        environment.insert(QStringLiteral("KDBUSSIMPLESERVICE_ACTIVATION_INTERVAL"), QString::number(60 * 1000));
+        QProcess process;
+        process.setProgram(QFINDTESTDATA("kdbussimpleservice"));
+        process.setProcessEnvironment(environment);
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+        process.start();
+        QVERIFY(process.waitForStarted());
+
+        QDBusConnection client = m_bus.connection(QStringLiteral("client"));
+        const QString serviceName = QStringLiteral("org.kde.kdbussimpleservice");
+        QTRY_VERIFY(client.interface()->isServiceRegistered(serviceName).value());
+
+        // The activating call arrives long after the service reached its event loop,
+        // it is still handled right away instead of after the activation interval
+        QTest::qWait(500);
+        QDBusMessage message = QDBusMessage::createMethodCall(serviceName,
+                                                              QStringLiteral("/org/kde/kdbussimpleservice"),
+                                                              QStringLiteral("org.freedesktop.Application"),
+                                                              QStringLiteral("Activate"));
+        message << QVariantMap();
+        client.asyncCall(message);
+
+        QTRY_COMPARE_WITH_TIMEOUT(process.state(), QProcess::NotRunning, 10000);
+        QCOMPARE(process.exitStatus(), QProcess::NormalExit);
+        QCOMPARE(process.exitCode(), 43);
+    }
+
+    void testActivationQueue()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        KDBusService service(KDBusService::Unique | KDBusService::NoExitOnFailure, connection);
+        QVERIFY(service.isRegistered());
+        service.setActivationQueueLimit(2);
+        service.setActivationInterval(60 * 1000);
+        service.setActivationMergePolicy(KDBusService::MergeDuplicateOpen);
+
+        QList<QUrl> opened;
+        QByteArrayList tokens;
+        connect(&service, &KDBusService::openRequested, this, [&opened, &tokens](const QList<QUrl> &urls) {
+            opened << urls;
+            tokens << qgetenv("XDG_ACTIVATION_TOKEN");
+        });
+
+        QDBusConnection client = m_bus.connection(QStringLiteral("client"));
+        const auto open = [&client, &service](const QString &uri, const QString &token = QString()) {
+            QDBusMessage message = QDBusMessage::createMethodCall(service.serviceName(),
+                                                                  QStringLiteral("/org/kde/kdbusserviceconnectiontest"),
+                                                                  QStringLiteral("org.freedesktop.Application"),
+                                                                  QStringLiteral("Open"));
+            QVariantMap platformData;
+            if (!token.isEmpty()) {
+                platformData.insert(QStringLiteral("activation-token"), token);
+            }
+            message << QStringList{uri} << platformData;
+            client.asyncCall(message);
+        };
+
+        // The repeated request is merged and its newer token goes to the queued one
+        open(QStringLiteral("file:///tmp/a.txt"), QStringLiteral("first"));
+        open(QStringLiteral("file:///tmp/b.txt"));
+        open(QStringLiteral("file:///tmp/a.txt"), QStringLiteral("second"));
+        QTRY_COMPARE(service.activationQueueStatistics().merged, 1u);
+        QCOMPARE(service.activationQueueStatistics().depth, 2);
+        QVERIFY(opened.isEmpty());
+
+        // A full queue hands the oldest request out while the caller waits
+        open(QStringLiteral("file:///tmp/c.txt"));
+        QTRY_COMPARE(opened.size(), 1);
+        QCOMPARE(opened.at(0), QUrl(QStringLiteral("file:///tmp/a.txt")));
+        QCOMPARE(tokens.at(0), QByteArrayLiteral("second"));
+        QCOMPARE(service.activationQueueStatistics().depth, 2);
+
+        // Without a limit, the queued requests still go before the new one
+        service.setActivationQueueLimit(0);
+        open(QStringLiteral("file:///tmp/d.txt"));
+        QTRY_COMPARE(opened.size(), 4);
+        QCOMPARE(opened,
+                 (QList<QUrl>{QUrl(QStringLiteral("file:///tmp/a.txt")),
+                              QUrl(QStringLiteral("file:///tmp/b.txt")),
+                              QUrl(QStringLiteral("file:///tmp/c.txt")),
+                              QUrl(QStringLiteral("file:///tmp/d.txt"))}));
+
+        // Queued requests are paced by the activation interval
+        service.setActivationQueueLimit(2);
+        service.setActivationInterval(20);
+        open(QStringLiteral("file:///tmp/e.txt"));
+        open(QStringLiteral("file:///tmp/f.txt"));
+        QTRY_COMPARE(opened.size(), 6);
+        QCOMPARE(opened.at(5), QUrl(QStringLiteral("file:///tmp/f.txt")));
+
+        const KDBusService::ActivationQueueStatistics statistics = service.activationQueueStatistics();
+        QCOMPARE(statistics.depth, 0);
+        QCOMPARE(statistics.peakDepth, 2);
+        QCOMPARE(statistics.processed, 5u);
+        QCOMPARE(statistics.merged, 1u);
+        QVERIFY(statistics.maxWaitTime >= 15);
+
+        service.unregister();
+    }
+
+    void testSharded()
+    {
+        KDBusService::setShardLimit(2);
+        // Routing by arguments would depend on how this test is run
+        KDBusService::setShardRouting(KDBusService::RouteToLeastLoaded);
+        const QString entryName = QStringLiteral("org.kde.kdbusserviceconnectiontest");
+
+        // A shard that answers from its own thread, so probing it does not wait for this one
+        QDBusConnection stubConnection = m_bus.connection(QStringLiteral("stub-shard"));
+        ShardStub stub;
+        QThread stubThread;
+        stub.moveToThread(&stubThread);
+        stubThread.start();
+        QVERIFY(stubConnection.registerVirtualObject(QStringLiteral("/org/kde/kdbusserviceconnectiontest"), &stub));
+        QVERIFY(stubConnection.registerService(entryName + QStringLiteral(".shard-0")));
+        QVERIFY(stubConnection.registerService(entryName));
+
+        // The idle shard is tried first, since it does not take the arguments the next one is used
+        QDBusConnection shardConnection = m_bus.connection(QStringLiteral("shard"));
+        KDBusService shard(KDBusService::Sharded | KDBusService::NoExitOnFailure, shardConnection);
+        QVERIFY(shard.isRegistered());
+        QCOMPARE(shard.shardIndex(), 1);
+        QCOMPARE(shard.serviceName(), entryName + QStringLiteral(".shard-1"));
+        QCOMPARE(stub.forwarded.loadRelaxed(), 1);
+
+        // The well-known name passes on to the remaining shard
+        QVERIFY(stubConnection.unregisterService(entryName));
+        QTRY_COMPARE(shardConnection.interface()->serviceOwner(entryName).value(), shardConnection.baseService());
+        shard.unregister();
+
+        // A busy shard is not sent anything, and with no free shard the instance runs on its own
+        KDBusService::setShardLimit(1);
+        stub.busy.storeRelaxed(true);
+        KDBusService standalone(KDBusService::Sharded | KDBusService::NoExitOnFailure, m_bus.connection(QStringLiteral("standalone")));
+        QVERIFY(standalone.isRegistered());
+        QCOMPARE(standalone.shardIndex(), -1);
+        QCOMPARE(standalone.serviceName(), entryName + QLatin1Char('-') + QString::number(QCoreApplication::applicationPid()));
+        QCOMPARE(stub.forwarded.loadRelaxed(), 1);
+        standalone.unregister();
+
+        stubConnection.unregisterObject(QStringLiteral("/org/kde/kdbusserviceconnectiontest"));
+        stubThread.quit();
+        stubThread.wait();
+        KDBusService::setShardLimit(0);
+        KDBusService::setShardRouting(KDBusService::RouteByArguments);
+    }
+
+    void testModule()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QVERIFY(connection.isConnected());
+
+        TestModule module;
+        module.setConnection(connection);
+        QSignalSpy spy(&module, &KDEDModule::moduleRegistered);
+        module.setModuleName(QStringLiteral("testmodule"));
+        QVERIFY(spy.wait());
+        QCOMPARE(spy.at(0).at(0).value<QDBusObjectPath>().path(), QStringLiteral("/modules/testmodule"));
+        QVERIFY(connection.objectRegisteredAt(QStringLiteral("/modules/testmodule")) == &module);
+    }
+
+private:
+    KDBusTestBus m_bus;
+};
+
+QTEST_GUILESS_MAIN(KDBusServiceConnectionTest)
+
+#include "kdbusserviceconnectiontest.moc"
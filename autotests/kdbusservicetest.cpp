@@ -9,6 +9,9 @@
 */
 
 #include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusReply>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
@@ -150,7 +153,35 @@ int main(int argc, char *argv[])
     qDebug() << "Terminating.";
 
     Q_ASSERT(testObject.callCount() == 3);
-    const bool ok = testObject.callCount() == 3;
+    bool ok = testObject.callCount() == 3;
+
+    // Both forwarded calls were measured, including the time spent in the duplicate instance.
+    // How long they took depends on the machine, kdbusservicebenchmark measures that.
+    const QList<KDBusService::ActivationLatency> latencies = service.activationLatencies();
+    Q_ASSERT(latencies.size() == 2);
+    for (const KDBusService::ActivationLatency &latency : latencies) {
+        Q_ASSERT(latency.method == QLatin1String("CommandLine"));
+        Q_ASSERT(latency.handlingTime >= 0 && latency.endToEndTime >= 0);
+        ok = ok && latency.handlingTime >= 0 && latency.endToEndTime >= 0;
+    }
+    ok = ok && latencies.size() == 2;
+
+    // The statistics for monitoring tools cover both calls, in order
+    const QDBusMessage message = QDBusMessage::createMethodCall(service.serviceName(),
+                                                                QStringLiteral("/org/kde/kdbusservicetest"),
+                                                                QStringLiteral("org.kde.KDBusService"),
+                                                                QStringLiteral("ActivationLatencyStatistics"));
+    const QDBusReply<QVariantMap> statistics = QDBusConnection::sessionBus().call(message);
+    Q_ASSERT(statistics.isValid());
+    for (const QString &prefix : {QStringLiteral("handling-"), QStringLiteral("end-to-end-")}) {
+        const QVariantMap values = statistics.value();
+        const qint64 p50 = values.value(prefix + QStringLiteral("p50"), -1).toLongLong();
+        const qint64 p95 = values.value(prefix + QStringLiteral("p95"), -1).toLongLong();
+        const qint64 max = values.value(prefix + QStringLiteral("max"), -1).toLongLong();
+        const bool ordered = values.value(prefix + QStringLiteral("count")).toLongLong() == 2 && 0 <= p50 && p50 <= p95 && p95 <= max;
+        Q_ASSERT(ordered);
+        ok = ok && ordered;
+    }
 
     return ok ? 0 : 1;
 }
@@ -73,6 +73,16 @@ int main(int argc, char *argv[])
     }
     qDebug() << "service registered";
 
+    // Paces activations, the first one is handled by exiting with 43
+    const int activationInterval = qEnvironmentVariableIntValue("KDBUSSIMPLESERVICE_ACTIVATION_INTERVAL");
+    if (activationInterval > 0) {
+        service.setActivationQueueLimit(1);
+        service.setActivationInterval(activationInterval);
+        QObject::connect(&service, &KDBusService::activateRequested, &app, []() {
+            QCoreApplication::exit(43);
+        });
+    }
+
     int ret = app.exec();
     qDebug() << "exiting deadservice";
     return ret;
@@ -0,0 +1,132 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusReply>
+#include <QSignalSpy>
+#include <QTest>
+
+#include <kdbustestbus.h>
+#include <kupdatelaunchenvironmentjob.h>
+
+class KDBusTestBusTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        if (!m_bus.start(KDBusTestBus::AllStubs)) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+        // KUpdateLaunchEnvironmentJob always talks to the session bus
+        m_bus.exportAsSessionBus();
+    }
+
+    void testIsolation()
+    {
+        QVERIFY(m_bus.isRunning());
+        QCOMPARE(m_bus.processEnvironment().value(QStringLiteral("DBUS_SESSION_BUS_ADDRESS")), m_bus.address());
+
+        QDBusConnection connection = m_bus.connection(QStringLiteral("client"));
+        QVERIFY(connection.isConnected());
+        QCOMPARE(m_bus.connection(QStringLiteral("client")).baseService(), connection.baseService());
+        QVERIFY(connection.interface()->isServiceRegistered(QStringLiteral("org.kde.Startup")).value());
+        QVERIFY(connection.interface()->isServiceRegistered(QStringLiteral("org.freedesktop.systemd1")).value());
+
+        // None of the services installed on the machine can be activated
+        const QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                                    QStringLiteral("/org/freedesktop/DBus"),
+                                                                    QStringLiteral("org.freedesktop.DBus"),
+                                                                    QStringLiteral("ListActivatableNames"));
+        const QDBusReply<QStringList> activatable = connection.call(message);
+        QVERIFY(activatable.isValid());
+        QCOMPARE(activatable.value(), QStringList{QStringLiteral("org.freedesktop.DBus")});
+    }
+
+    void testUpdateLaunchEnvironment()
+    {
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KDBUSTESTBUS_VAR"), QStringLiteral("value"));
+
+        auto *job = new KUpdateLaunchEnvironmentJob(environment);
+        KLaunchEnvironmentState::Backends acknowledged;
+        connect(job, &KUpdateLaunchEnvironmentJob::finished, this, [job, &acknowledged]() {
+            acknowledged = job->acknowledgedBackends();
+        });
+        QSignalSpy spy(job, &KUpdateLaunchEnvironmentJob::finished);
+        QVERIFY(spy.wait());
+
+        QCOMPARE(acknowledged, KLaunchEnvironmentState::AllBackends);
+        QCOMPARE(m_bus.startupEnvironment().value(QStringLiteral("KDBUSTESTBUS_VAR")), QStringLiteral("value"));
+        QCOMPARE(m_bus.systemdEnvironment(), QStringList{QStringLiteral("KDBUSTESTBUS_VAR=value")});
+    }
+
+    void testFailingStub()
+    {
+        m_bus.setFailingStubs(KDBusTestBus::SystemdStub);
+
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KDBUSTESTBUS_VAR"), QStringLiteral("other"));
+
+        auto *job = new KUpdateLaunchEnvironmentJob(environment);
+        KLaunchEnvironmentState::Backends acknowledged;
+        connect(job, &KUpdateLaunchEnvironmentJob::finished, this, [job, &acknowledged]() {
+            acknowledged = job->acknowledgedBackends();
+        });
+        QSignalSpy spy(job, &KUpdateLaunchEnvironmentJob::finished);
+        QVERIFY(spy.wait());
+
+        QCOMPARE(acknowledged, KLaunchEnvironmentState::PlasmaSession | KLaunchEnvironmentState::DBusActivation);
+        QCOMPARE(m_bus.startupEnvironment().value(QStringLiteral("KDBUSTESTBUS_VAR")), QStringLiteral("other"));
+        QCOMPARE(m_bus.systemdEnvironment(), QStringList{QStringLiteral("KDBUSTESTBUS_VAR=value")});
+
+        m_bus.setFailingStubs(KDBusTestBus::NoStubs);
+    }
+
+    void testMeasureLatency()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("client"));
+        const QDBusMessage message = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                                    QStringLiteral("/org/freedesktop/DBus"),
+                                                                    QStringLiteral("org.freedesktop.DBus.Peer"),
+                                                                    QStringLiteral("Ping"));
+        const QList<qint64> latencies = KDBusTestBus::measureLatency(connection, message, 10);
+        QCOMPARE(latencies.size(), 10);
+
+        const KDBusTestBus::LatencyStatistics statistics = KDBusTestBus::latencyStatistics(latencies);
+        QCOMPARE(statistics.count, 10);
+        QVERIFY(statistics.p50 > 0);
+        QVERIFY(statistics.p50 <= statistics.p99);
+        QVERIFY(statistics.p99 <= statistics.max);
+    }
+
+    void testLatencyStatistics()
+    {
+        QList<qint64> samples;
+        for (int i = 100; i > 0; --i) {
+            samples.append(i);
+        }
+        const KDBusTestBus::LatencyStatistics statistics = KDBusTestBus::latencyStatistics(samples);
+        QCOMPARE(statistics.count, 100);
+        QCOMPARE(statistics.p50, 50);
+        QCOMPARE(statistics.p99, 99);
+        QCOMPARE(statistics.max, 100);
+
+        QCOMPARE(KDBusTestBus::latencyStatistics({}).count, 0);
+    }
+
+private:
+    KDBusTestBus m_bus;
+};
+
+QTEST_GUILESS_MAIN(KDBusTestBusTest)
+
+#include "kdbustestbustest.moc"
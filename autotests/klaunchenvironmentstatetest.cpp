@@ -0,0 +1,113 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QSignalSpy>
+#include <QTest>
+
+#include <kdbustestbus.h>
+#include <klaunchenvironmentstate.h>
+#include <kupdatelaunchenvironmentjob.h>
+
+class KLaunchEnvironmentStateTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        if (!m_bus.start(KDBusTestBus::AllStubs)) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+        // KUpdateLaunchEnvironmentJob always talks to the session bus
+        m_bus.exportAsSessionBus();
+    }
+
+    void init()
+    {
+        KLaunchEnvironmentState::clear();
+        m_bus.setFailingStubs(KDBusTestBus::NoStubs);
+    }
+
+    void testAcknowledged()
+    {
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_FIRST"), QStringLiteral("1"));
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_SECOND"), QStringLiteral("2"));
+
+        QVERIFY(!KLaunchEnvironmentState::contains(environment));
+        QCOMPARE(KLaunchEnvironmentState::missing(environment), environment);
+
+        QVERIFY(updateLaunchEnvironment(environment));
+        QVERIFY(KLaunchEnvironmentState::contains(environment));
+        QVERIFY(KLaunchEnvironmentState::missing(environment).isEmpty());
+        QCOMPARE(KLaunchEnvironmentState::environment(KLaunchEnvironmentState::Systemd), environment);
+
+        // Only the variable whose value changed is missing
+        QProcessEnvironment changed = environment;
+        changed.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_SECOND"), QStringLiteral("3"));
+        QProcessEnvironment expected;
+        expected.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_SECOND"), QStringLiteral("3"));
+        QVERIFY(!KLaunchEnvironmentState::contains(changed));
+        QCOMPARE(KLaunchEnvironmentState::missing(changed), expected);
+
+        KLaunchEnvironmentState::clear();
+        QVERIFY(!KLaunchEnvironmentState::contains(environment));
+    }
+
+    void testNeverSynced()
+    {
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_VALID"), QStringLiteral("1"));
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE-INVALID"), QStringLiteral("2"));
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_CONTROL"), QStringLiteral("a\x01b"));
+
+        // A name no backend accepts is not missing, so updating the missing variables settles them
+        QProcessEnvironment expected;
+        expected.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_VALID"), QStringLiteral("1"));
+        expected.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_CONTROL"), QStringLiteral("a\x01b"));
+        const QProcessEnvironment missing = KLaunchEnvironmentState::missing(environment);
+        QCOMPARE(missing, expected);
+
+        QVERIFY(updateLaunchEnvironment(missing));
+        QVERIFY(KLaunchEnvironmentState::missing(environment).isEmpty());
+        QVERIFY(KLaunchEnvironmentState::contains(environment));
+        // systemd never got the value with a control character
+        QVERIFY(!KLaunchEnvironmentState::environment(KLaunchEnvironmentState::Systemd).contains(QStringLiteral("KLAUNCHENVIRONMENTSTATE_CONTROL")));
+        QVERIFY(KLaunchEnvironmentState::environment(KLaunchEnvironmentState::DBusActivation).contains(QStringLiteral("KLAUNCHENVIRONMENTSTATE_CONTROL")));
+    }
+
+    void testFailingBackend()
+    {
+        m_bus.setFailingStubs(KDBusTestBus::SystemdStub);
+
+        QProcessEnvironment environment;
+        environment.insert(QStringLiteral("KLAUNCHENVIRONMENTSTATE_THIRD"), QStringLiteral("3"));
+        QVERIFY(updateLaunchEnvironment(environment));
+
+        // What systemd refused is still missing for it, and only for it
+        QVERIFY(KLaunchEnvironmentState::contains(environment, KLaunchEnvironmentState::PlasmaSession | KLaunchEnvironmentState::DBusActivation));
+        QVERIFY(!KLaunchEnvironmentState::contains(environment));
+        QCOMPARE(KLaunchEnvironmentState::missing(environment, KLaunchEnvironmentState::Systemd), environment);
+        QVERIFY(KLaunchEnvironmentState::missing(environment, KLaunchEnvironmentState::PlasmaSession).isEmpty());
+        QVERIFY(KLaunchEnvironmentState::environment(KLaunchEnvironmentState::Systemd).isEmpty());
+    }
+
+private:
+    bool updateLaunchEnvironment(const QProcessEnvironment &environment)
+    {
+        auto *job = new KUpdateLaunchEnvironmentJob(environment);
+        QSignalSpy spy(job, &KUpdateLaunchEnvironmentJob::finished);
+        return spy.wait();
+    }
+
+    KDBusTestBus m_bus;
+};
+
+QTEST_GUILESS_MAIN(KLaunchEnvironmentStateTest)
+
+#include "klaunchenvironmentstatetest.moc"
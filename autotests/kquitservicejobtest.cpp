@@ -0,0 +1,150 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QSignalSpy>
+#include <QTest>
+#include <QTimer>
+
+#include <kdbustestbus.h>
+#include <kquitservicejob.h>
+
+static const QString s_serviceName = QStringLiteral("org.kde.kquitservicejobtest");
+
+// Stands in for the application object of the service that is asked to quit
+class QuitObject : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.KQuitServiceJobTest")
+
+public:
+    QuitObject(const QDBusConnection &connection, bool release)
+        : m_connection(connection)
+        , m_release(release)
+    {
+    }
+
+    int calls = 0;
+
+public Q_SLOTS:
+    Q_SCRIPTABLE void quit()
+    {
+        ++calls;
+        if (m_release) {
+            // Like an application quitting its event loop after replying
+            QTimer::singleShot(0, this, [this]() {
+                m_connection.unregisterService(s_serviceName);
+            });
+        }
+    }
+
+private:
+    QDBusConnection m_connection;
+    bool m_release;
+};
+
+class KQuitServiceJobTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase()
+    {
+        if (!m_bus.start()) {
+            QSKIP("Could not start a private dbus-daemon");
+        }
+        m_client = m_bus.connection(QStringLiteral("client"));
+    }
+
+    void testWaitForRelease()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QuitObject object(connection, true);
+        QVERIFY(connection.registerObject(QStringLiteral("/MainApplication"), &object, QDBusConnection::ExportScriptableSlots));
+        QVERIFY(connection.registerService(s_serviceName));
+
+        const QDBusError error = runJob(true, 5000);
+        QVERIFY2(!error.isValid(), qPrintable(error.message()));
+        QCOMPARE(object.calls, 1);
+        QVERIFY(!m_client.interface()->isServiceRegistered(s_serviceName).value());
+
+        connection.unregisterObject(QStringLiteral("/MainApplication"));
+    }
+
+    void testWaitForReleaseToQueued()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QuitObject object(connection, true);
+        QVERIFY(connection.registerObject(QStringLiteral("/MainApplication"), &object, QDBusConnection::ExportScriptableSlots));
+        QVERIFY(connection.registerService(s_serviceName));
+
+        // The name passes on to the queued connection instead of becoming unowned
+        QDBusConnection successor = m_bus.connection(QStringLiteral("successor"));
+        QCOMPARE(successor.interface()->registerService(s_serviceName, QDBusConnectionInterface::QueueService).value(),
+                 QDBusConnectionInterface::ServiceQueued);
+
+        const QDBusError error = runJob(true, 5000);
+        QVERIFY2(!error.isValid(), qPrintable(error.message()));
+        QCOMPARE(m_client.interface()->serviceOwner(s_serviceName).value(), successor.baseService());
+
+        successor.unregisterService(s_serviceName);
+        connection.unregisterObject(QStringLiteral("/MainApplication"));
+    }
+
+    void testTimeout()
+    {
+        QDBusConnection connection = m_bus.connection(QStringLiteral("service"));
+        QuitObject object(connection, false);
+        QVERIFY(connection.registerObject(QStringLiteral("/MainApplication"), &object, QDBusConnection::ExportScriptableSlots));
+        QVERIFY(connection.registerService(s_serviceName));
+
+        // The service answers, but keeps its name
+        const QDBusError error = runJob(true, 500);
+        QCOMPARE(error.type(), QDBusError::Timeout);
+        QCOMPARE(object.calls, 1);
+        QVERIFY(m_client.interface()->isServiceRegistered(s_serviceName).value());
+
+        connection.unregisterService(s_serviceName);
+        connection.unregisterObject(QStringLiteral("/MainApplication"));
+    }
+
+    void testServiceUnknown()
+    {
+        QVERIFY(!m_client.interface()->isServiceRegistered(s_serviceName).value());
+
+        const QDBusError error = runJob(false, 5000);
+        QCOMPARE(error.type(), QDBusError::ServiceUnknown);
+    }
+
+private:
+    QDBusError runJob(bool waitForRelease, int timeout)
+    {
+        auto *job = new KQuitServiceJob(s_serviceName);
+        job->setConnection(m_client);
+        job->setWaitForRelease(waitForRelease);
+        job->setTimeout(timeout);
+
+        QDBusError error;
+        connect(job, &KQuitServiceJob::finished, this, [job, &error]() {
+            error = job->error();
+        });
+        QSignalSpy spy(job, &KQuitServiceJob::finished);
+        if (!spy.wait(timeout + 5000)) {
+            return QDBusError(QDBusError::Other, QStringLiteral("The job did not finish"));
+        }
+        return error;
+    }
+
+    KDBusTestBus m_bus;
+    QDBusConnection m_client = QDBusConnection(QString());
+};
+
+QTEST_MAIN(KQuitServiceJobTest)
+
+#include "kquitservicejobtest.moc"
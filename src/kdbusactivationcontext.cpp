@@ -0,0 +1,65 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kdbusactivationcontext.h"
+
+class KDBusActivationContextPrivate : public QSharedData
+{
+public:
+    QVariantMap platformData;
+    QByteArray activationToken;
+    QByteArray desktopStartupId;
+    bool valid = false;
+};
+
+static QByteArray platformDataValue(const QVariantMap &platformData, const QString &key)
+{
+    const auto it = platformData.constFind(key);
+    return it == platformData.constEnd() ? QByteArray() : it->toByteArray();
+}
+
+KDBusActivationContext::KDBusActivationContext()
+    : d(new KDBusActivationContextPrivate)
+{
+}
+
+KDBusActivationContext::KDBusActivationContext(const QVariantMap &platformData)
+    : d(new KDBusActivationContextPrivate)
+{
+    // The map is implicitly shared with the demarshalled message, the token is only converted once here
+    d->platformData = platformData;
+    d->activationToken = platformDataValue(platformData, QStringLiteral("activation-token"));
+    d->desktopStartupId = platformDataValue(platformData, QStringLiteral("desktop-startup-id"));
+    d->valid = true;
+}
+
+KDBusActivationContext::KDBusActivationContext(const KDBusActivationContext &other) = default;
+
+KDBusActivationContext &KDBusActivationContext::operator=(const KDBusActivationContext &other) = default;
+
+KDBusActivationContext::~KDBusActivationContext() = default;
+
+bool KDBusActivationContext::isValid() const
+{
+    return d->valid;
+}
+
+QByteArray KDBusActivationContext::activationToken() const
+{
+    return d->activationToken;
+}
+
+QByteArray KDBusActivationContext::desktopStartupId() const
+{
+    return d->desktopStartupId;
+}
+
+QVariantMap KDBusActivationContext::platformData() const
+{
+    return d->platformData;
+}
@@ -0,0 +1,79 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSACTIVATIONCONTEXT_H
+#define KDBUSACTIVATIONCONTEXT_H
+
+#include <kdbusaddons_export.h>
+
+#include <QByteArray>
+#include <QSharedDataPointer>
+#include <QVariantMap>
+
+class KDBusActivationContextPrivate;
+
+/*!
+ * \class KDBusActivationContext
+ * \inmodule KDBusAddons
+ * \brief The platform data that came with an activation request.
+ *
+ * Every activation method of the D-Bus activation interface carries a
+ * dictionary of platform data, which among other things holds the token
+ * for the startup notification of the window system. KDBusActivationContext
+ * gives structured access to it, so applications do not have to go through
+ * the environment to find the token.
+ *
+ * \sa KDBusService::activationContext()
+ *
+ * \since 6.28
+ */
+class KDBUSADDONS_EXPORT KDBusActivationContext
+{
+public:
+    /*!
+     * Creates an empty activation context.
+     */
+    KDBusActivationContext();
+
+    /*!
+     * Creates an activation context for the given \a platformData,
+     * as passed to the methods of \c org.freedesktop.Application.
+     */
+    explicit KDBusActivationContext(const QVariantMap &platformData);
+
+    KDBusActivationContext(const KDBusActivationContext &other);
+    KDBusActivationContext &operator=(const KDBusActivationContext &other);
+    ~KDBusActivationContext();
+
+    /*!
+     * Returns whether this context was created for an activation request.
+     */
+    bool isValid() const;
+
+    /*!
+     * Returns the token for the XDG Activation protocol used on Wayland,
+     * or an empty byte array if there is none.
+     */
+    QByteArray activationToken() const;
+
+    /*!
+     * Returns the id for the Startup Notification protocol used on X11,
+     * or an empty byte array if there is none.
+     */
+    QByteArray desktopStartupId() const;
+
+    /*!
+     * Returns the complete platform data of the request.
+     */
+    QVariantMap platformData() const;
+
+private:
+    QSharedDataPointer<KDBusActivationContextPrivate> d;
+};
+
+#endif
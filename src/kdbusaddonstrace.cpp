@@ -0,0 +1,127 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kdbusaddonstrace_p.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QThread>
+
+#include "kdbusaddons_debug.h"
+
+#include <chrono>
+
+namespace
+{
+class TraceWriter
+{
+public:
+    TraceWriter()
+    {
+        QString fileName = qEnvironmentVariable("KDBUSADDONS_TRACE_FILE");
+        if (fileName.isEmpty()) {
+            return;
+        }
+        fileName.replace(QLatin1String("%p"), QString::number(QCoreApplication::applicationPid()));
+
+        file.setFileName(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qCWarning(KDBUSADDONS_LOG) << "Could not open trace file" << fileName << file.errorString();
+            return;
+        }
+        // The closing bracket is optional in the JSON array format, which lets us append until we exit
+        file.write("[\n");
+
+        QString processName = QCoreApplication::applicationName();
+        if (processName.isEmpty() && QCoreApplication::instance()) {
+            processName = QCoreApplication::arguments().constFirst();
+        }
+        write(QJsonObject{
+            {QStringLiteral("name"), QStringLiteral("process_name")},
+            {QStringLiteral("ph"), QStringLiteral("M")},
+            {QStringLiteral("pid"), QCoreApplication::applicationPid()},
+            {QStringLiteral("args"), QJsonObject{{QStringLiteral("name"), processName}}},
+        });
+    }
+
+    bool isOpen() const
+    {
+        return file.isOpen();
+    }
+
+    void write(const QJsonObject &event)
+    {
+        const QMutexLocker locker(&mutex);
+        file.write(QJsonDocument(event).toJson(QJsonDocument::Compact));
+        file.write(",\n");
+        file.flush();
+    }
+
+private:
+    QMutex mutex;
+    QFile file;
+};
+
+TraceWriter &writer()
+{
+    static TraceWriter writer;
+    return writer;
+}
+
+QJsonObject event(const char *category, const QString &name, const char *phase, qint64 timestamp)
+{
+    return QJsonObject{
+        {QStringLiteral("cat"), QLatin1String(category)},
+        {QStringLiteral("name"), name},
+        {QStringLiteral("ph"), QLatin1String(phase)},
+        {QStringLiteral("ts"), timestamp},
+        {QStringLiteral("pid"), QCoreApplication::applicationPid()},
+        {QStringLiteral("tid"), qint64(reinterpret_cast<quintptr>(QThread::currentThreadId()))},
+    };
+}
+}
+
+bool KDBusAddonsTrace::isEnabled()
+{
+    static const bool enabled = writer().isOpen();
+    return enabled;
+}
+
+qint64 KDBusAddonsTrace::timestamp()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+}
+
+void KDBusAddonsTrace::completeEvent(const char *category, const QString &name, qint64 begin, const QJsonObject &args)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QJsonObject complete = event(category, name, "X", begin);
+    complete.insert(QStringLiteral("dur"), timestamp() - begin);
+    if (!args.isEmpty()) {
+        complete.insert(QStringLiteral("args"), args);
+    }
+    writer().write(complete);
+}
+
+void KDBusAddonsTrace::instantEvent(const char *category, const QString &name, const QJsonObject &args)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    QJsonObject instant = event(category, name, "i", timestamp());
+    instant.insert(QStringLiteral("s"), QStringLiteral("t"));
+    if (!args.isEmpty()) {
+        instant.insert(QStringLiteral("args"), args);
+    }
+    writer().write(instant);
+}
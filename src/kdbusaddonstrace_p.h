@@ -0,0 +1,68 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSADDONSTRACE_P_H
+#define KDBUSADDONSTRACE_P_H
+
+#include <QJsonObject>
+#include <QString>
+
+// Writes Chrome trace event format JSON, which Perfetto and chrome://tracing load,
+// to the file named by KDBUSADDONS_TRACE_FILE. "%p" in the name is replaced by the PID.
+// Timestamps are taken from the monotonic clock, so traces of several processes line up.
+namespace KDBusAddonsTrace
+{
+bool isEnabled();
+
+// Microseconds on the monotonic clock
+qint64 timestamp();
+
+void completeEvent(const char *category, const QString &name, qint64 begin, const QJsonObject &args = QJsonObject());
+void instantEvent(const char *category, const QString &name, const QJsonObject &args = QJsonObject());
+
+// Records a complete event covering its own lifetime
+class Span
+{
+public:
+    Span(const char *category, const QString &name)
+        : m_category(category)
+        , m_name(name)
+        , m_begin(isEnabled() ? timestamp() : 0)
+    {
+    }
+
+    ~Span()
+    {
+        end();
+    }
+
+    // Records the event right away, for instance before calling exit()
+    void end()
+    {
+        if (m_begin) {
+            completeEvent(m_category, m_name, m_begin, m_args);
+            m_begin = 0;
+        }
+    }
+
+    void setArgument(const QString &key, const QJsonValue &value)
+    {
+        m_args.insert(key, value);
+    }
+
+private:
+    Q_DISABLE_COPY(Span)
+
+    const char *const m_category;
+    const QString m_name;
+    qint64 m_begin;
+    QJsonObject m_args;
+};
+}
+
+#endif
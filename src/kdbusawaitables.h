@@ -0,0 +1,199 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSAWAITABLES_H
+#define KDBUSAWAITABLES_H
+
+#include <QDBusMessage>
+#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+
+#include <kquitservicejob.h>
+#include <kupdatelaunchenvironmentjob.h>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+
+#include <coroutine>
+#include <functional>
+
+/*!
+ * \namespace KDBusAddons
+ * \inmodule KDBusAddons
+ * \brief C++20 coroutine support for the asynchronous operations of KDBusAddons.
+ *
+ * The functions return objects that can be awaited with \c co_await in any
+ * coroutine type, for example the tasks of QCoro. The operation starts when
+ * it is awaited, and the coroutine resumes in the thread of the event loop
+ * once it has finished:
+ *
+ * \code
+ * QCoro::Task<> startSession()
+ * {
+ *     const auto backends = co_await KDBusAddons::updateLaunchEnvironment(environment);
+ *     if (!(backends & KLaunchEnvironmentState::Systemd)) {
+ *         // ...
+ *     }
+ *     const QDBusMessage reply = co_await KDBusAddons::call(QDBusConnection::sessionBus().asyncCall(message));
+ * }
+ * \endcode
+ *
+ * These awaitables are only available when compiling with coroutine support.
+ *
+ * There is no awaitable for the registration of KDBusService. A second
+ * instance forwards its arguments and exits from within the constructor,
+ * before the application has created any window or started its event loop.
+ * Awaiting the registration would have to run the event loop first, so the
+ * second instance could show up before exiting, and the first instance could
+ * receive \c Activate or \c Open calls before deciding whether it is the
+ * primary one. Create the KDBusService before starting the coroutine instead.
+ *
+ * \since 6.28
+ */
+namespace KDBusAddons
+{
+namespace Private
+{
+// Starts a self-deleting job when awaited and resumes once it emitted finished()
+template<typename Job, typename Result>
+class JobAwaiter
+{
+public:
+    JobAwaiter(std::function<Job *()> create, Result (*resultOf)(const Job *))
+        : m_create(std::move(create))
+        , m_resultOf(resultOf)
+    {
+    }
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        Job *job = m_create();
+        QObject::connect(
+            job,
+            &Job::finished,
+            job,
+            [this, job, handle]() {
+                m_result = m_resultOf(job);
+                handle.resume();
+            },
+            Qt::SingleShotConnection);
+    }
+
+    Result await_resume()
+    {
+        return std::move(m_result);
+    }
+
+private:
+    std::function<Job *()> m_create;
+    Result (*m_resultOf)(const Job *);
+    Result m_result{};
+};
+
+class PendingCallAwaiter
+{
+public:
+    explicit PendingCallAwaiter(const QDBusPendingCall &call)
+        : m_call(call)
+    {
+    }
+
+    bool await_ready() const
+    {
+        return m_call.isFinished();
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto *watcher = new QDBusPendingCallWatcher(m_call);
+        QObject::connect(watcher, &QDBusPendingCallWatcher::finished, watcher, [handle](QDBusPendingCallWatcher *watcher) {
+            watcher->deleteLater();
+            handle.resume();
+        });
+    }
+
+    QDBusMessage await_resume() const
+    {
+        return m_call.reply();
+    }
+
+private:
+    QDBusPendingCall m_call;
+};
+}
+
+/*!
+ * Updates the launch \a environment like KUpdateLaunchEnvironmentJob.
+ *
+ * Awaiting the result gives the backends that acknowledged all variables.
+ */
+inline Private::JobAwaiter<KUpdateLaunchEnvironmentJob, KLaunchEnvironmentState::Backends> updateLaunchEnvironment(const QProcessEnvironment &environment)
+{
+    return {[environment]() {
+                return new KUpdateLaunchEnvironmentJob(environment);
+            },
+            [](const KUpdateLaunchEnvironmentJob *job) {
+                return job->acknowledgedBackends();
+            }};
+}
+
+/*!
+ * Quits the application registered as \a serviceName on the bus of
+ * \a connection like KQuitServiceJob, and waits until it released its name.
+ *
+ * Awaiting the result gives the error, which is invalid on success.
+ */
+inline Private::JobAwaiter<KQuitServiceJob, QDBusError> quitService(const QString &serviceName, const QDBusConnection &connection)
+{
+    return {[serviceName, connection]() {
+                auto *job = new KQuitServiceJob(serviceName);
+                job->setConnection(connection);
+                job->setWaitForRelease(true);
+                return job;
+            },
+            [](const KQuitServiceJob *job) {
+                return job->error();
+            }};
+}
+
+/*!
+ * \overload
+ *
+ * Quits the application registered as \a serviceName on the session bus.
+ */
+inline Private::JobAwaiter<KQuitServiceJob, QDBusError> quitService(const QString &serviceName)
+{
+    // The job connects to the session bus only once it starts
+    return {[serviceName]() {
+                auto *job = new KQuitServiceJob(serviceName);
+                job->setWaitForRelease(true);
+                return job;
+            },
+            [](const KQuitServiceJob *job) {
+                return job->error();
+            }};
+}
+
+/*!
+ * Waits for the pending D-Bus \a call.
+ *
+ * Awaiting the result gives the reply or error message.
+ */
+inline Private::PendingCallAwaiter call(const QDBusPendingCall &call)
+{
+    return Private::PendingCallAwaiter(call);
+}
+}
+
+#endif
+
+#endif
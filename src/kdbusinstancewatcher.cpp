@@ -0,0 +1,129 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kdbusinstancewatcher.h"
+
+#include <QDBusConnectionInterface>
+#include <QDBusServiceWatcher>
+#include <QSet>
+
+#include <algorithm>
+
+#include "kdbusaddons_debug.h"
+
+class KDBusInstanceWatcherPrivate
+{
+public:
+    KDBusInstanceWatcherPrivate(KDBusInstanceWatcher *q, const QString &serviceName, const QDBusConnection &connection);
+
+    static bool isNumber(QStringView text);
+
+    KDBusInstanceWatcher *q;
+    QString serviceName;
+    QDBusServiceWatcher watcher;
+    QSet<QString> instances;
+};
+
+KDBusInstanceWatcherPrivate::KDBusInstanceWatcherPrivate(KDBusInstanceWatcher *q, const QString &serviceName, const QDBusConnection &connection)
+    : q(q)
+    , serviceName(serviceName)
+{
+    // Multiple instances append "-<pid>", which is no namespace of their own,
+    // so the match rule has to cover the namespace of the application
+    const qsizetype lastDot = serviceName.lastIndexOf(QLatin1Char('.'));
+    const QString pattern = lastDot > 0 ? serviceName.left(lastDot) + QStringLiteral(".*") : serviceName;
+
+    watcher.setConnection(connection);
+    watcher.setWatchMode(QDBusServiceWatcher::WatchForRegistration | QDBusServiceWatcher::WatchForUnregistration);
+    // The match rule is in place before the names are listed, so none can slip through in between
+    watcher.addWatchedService(pattern);
+    // The pattern also matches the other applications of the namespace, like every org.kde.*
+    // name for org.kde.app, so their names are dropped before anything else is done with them
+    QObject::connect(&watcher, &QDBusServiceWatcher::serviceRegistered, q, [this](const QString &name) {
+        if (!this->q->isInstance(name)) {
+            return;
+        }
+        if (!instances.contains(name)) {
+            instances.insert(name);
+            Q_EMIT this->q->instanceAdded(name);
+        }
+    });
+    QObject::connect(&watcher, &QDBusServiceWatcher::serviceUnregistered, q, [this](const QString &name) {
+        if (!this->q->isInstance(name)) {
+            return;
+        }
+        if (instances.remove(name)) {
+            Q_EMIT this->q->instanceRemoved(name);
+        }
+    });
+
+    QDBusConnectionInterface *bus = connection.interface();
+    if (!bus) {
+        qCWarning(KDBUSADDONS_LOG) << "Cannot list the instances of" << serviceName << "without a bus connection";
+        return;
+    }
+    const QStringList names = bus->registeredServiceNames().value();
+    for (const QString &name : names) {
+        if (q->isInstance(name)) {
+            instances.insert(name);
+        }
+    }
+}
+
+bool KDBusInstanceWatcherPrivate::isNumber(QStringView text)
+{
+    return !text.isEmpty() && std::all_of(text.begin(), text.end(), [](QChar c) {
+        return c.isDigit();
+    });
+}
+
+KDBusInstanceWatcher::KDBusInstanceWatcher(const QString &serviceName, QObject *parent)
+    : KDBusInstanceWatcher(serviceName, QDBusConnection::sessionBus(), parent)
+{
+}
+
+KDBusInstanceWatcher::KDBusInstanceWatcher(const QString &serviceName, const QDBusConnection &connection, QObject *parent)
+    : QObject(parent)
+    , d(new KDBusInstanceWatcherPrivate(this, serviceName, connection))
+{
+}
+
+KDBusInstanceWatcher::~KDBusInstanceWatcher() = default;
+
+QString KDBusInstanceWatcher::serviceName() const
+{
+    return d->serviceName;
+}
+
+QStringList KDBusInstanceWatcher::instances() const
+{
+    QStringList instances(d->instances.cbegin(), d->instances.cend());
+    instances.sort();
+    return instances;
+}
+
+bool KDBusInstanceWatcher::isInstance(const QString &name) const
+{
+    if (!name.startsWith(d->serviceName)) {
+        return false;
+    }
+    const QStringView suffix = QStringView(name).mid(d->serviceName.size());
+    if (suffix.isEmpty()) {
+        return true; // the Unique instance
+    }
+    if (suffix.startsWith(QLatin1Char('-'))) {
+        return KDBusInstanceWatcherPrivate::isNumber(suffix.mid(1));
+    }
+    if (suffix.startsWith(QLatin1String(".shard-"))) {
+        return KDBusInstanceWatcherPrivate::isNumber(suffix.mid(7));
+    }
+    // Multiple instances inside Flatpak
+    return suffix.startsWith(QLatin1String(".kdbus-")) && suffix.size() > 7;
+}
+
+#include "moc_kdbusinstancewatcher.cpp"
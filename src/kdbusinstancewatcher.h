@@ -0,0 +1,98 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSINSTANCEWATCHER_H
+#define KDBUSINSTANCEWATCHER_H
+
+#include <kdbusaddons_export.h>
+
+#include <QDBusConnection>
+#include <QObject>
+
+#include <memory>
+
+class KDBusInstanceWatcherPrivate;
+
+/*!
+ * \class KDBusInstanceWatcher
+ * \inmodule KDBusAddons
+ * \brief Lists and watches the running instances of an application.
+ *
+ * A KDBusService registers every instance in \c Multiple mode under its own
+ * name, like \e org.kde.konsole-1234, or \e org.kde.konsole.kdbus-1_42 inside
+ * Flatpak. Finding them all used to mean scanning every name on the bus.
+ *
+ * KDBusInstanceWatcher lists the names on the bus once, and then keeps its
+ * list of instances up to date from the \c NameOwnerChanged signals of a
+ * single match rule. The rule is limited to the namespace the application
+ * lives in, \e org.kde for \e org.kde.konsole. The unique instance name,
+ * shards and \c Multiple instances are all reported.
+ *
+ * \code
+ * auto watcher = new KDBusInstanceWatcher(QStringLiteral("org.kde.konsole"), this);
+ * for (const QString &instance : watcher->instances()) {
+ *     // ...
+ * }
+ * connect(watcher, &KDBusInstanceWatcher::instanceAdded, this, &MyClass::addInstance);
+ * \endcode
+ *
+ * \sa KDBusService::serviceName()
+ *
+ * \since 6.28
+ */
+class KDBUSADDONS_EXPORT KDBusInstanceWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a watcher for the instances of \a serviceName on the session bus, with the given \a parent.
+     *
+     * \a serviceName is the name of the application without any instance
+     * suffix, like \e org.kde.konsole.
+     */
+    explicit KDBusInstanceWatcher(const QString &serviceName, QObject *parent = nullptr);
+
+    /*!
+     * Creates a watcher for the instances of \a serviceName on the bus of \a connection, with the given \a parent.
+     */
+    KDBusInstanceWatcher(const QString &serviceName, const QDBusConnection &connection, QObject *parent = nullptr);
+
+    ~KDBusInstanceWatcher() override;
+
+    /*!
+     * Returns the name of the application whose instances are watched.
+     */
+    QString serviceName() const;
+
+    /*!
+     * Returns the service names of the running instances.
+     */
+    QStringList instances() const;
+
+    /*!
+     * Returns whether \a name is the service name of an instance of the application.
+     */
+    bool isInstance(const QString &name) const;
+
+Q_SIGNALS:
+    /*!
+     * Emitted when an instance registered with the service name \a name.
+     */
+    void instanceAdded(const QString &name);
+
+    /*!
+     * Emitted when the instance registered with the service name \a name went away.
+     */
+    void instanceRemoved(const QString &name);
+
+private:
+    std::unique_ptr<KDBusInstanceWatcherPrivate> const d;
+};
+
+#endif
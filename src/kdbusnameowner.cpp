@@ -0,0 +1,65 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kdbusnameowner_p.h"
+
+#include <QDBusConnectionInterface>
+#include <QDBusReply>
+#include <QDBusServiceWatcher>
+#include <QMutex>
+#include <QSemaphore>
+#include <QThread>
+
+#include <memory>
+
+bool KDBusNameOwner::waitFor(const QDBusConnection &connection,
+                             const QString &serviceName,
+                             const std::function<bool(const QString &owner)> &isDone,
+                             const QDeadlineTimer &deadline,
+                             QString *owner)
+{
+    QSemaphore semaphore;
+    QMutex mutex;
+    QString newOwner;
+
+    QThread thread;
+    auto watcher = std::make_unique<QDBusServiceWatcher>(serviceName, connection, QDBusServiceWatcher::WatchForOwnerChange);
+    watcher->moveToThread(&thread);
+    QObject::connect(
+        watcher.get(),
+        &QDBusServiceWatcher::serviceOwnerChanged,
+        watcher.get(),
+        [&](const QString &, const QString &, const QString &changedOwner) {
+            if (isDone(changedOwner)) {
+                const QMutexLocker locker(&mutex);
+                newOwner = changedOwner;
+                semaphore.release();
+            }
+        },
+        Qt::DirectConnection);
+    thread.start();
+
+    // The watcher subscribed before, on the same connection, so no change after this answer is missed
+    const QDBusReply<QString> reply = connection.interface()->serviceOwner(serviceName);
+    QString result = reply.isValid() ? reply.value() : QString();
+    bool done = isDone(result);
+    if (!done && semaphore.tryAcquire(1, deadline)) {
+        const QMutexLocker locker(&mutex);
+        result = newOwner;
+        done = true;
+    }
+
+    thread.quit();
+    thread.wait();
+    watcher.reset();
+
+    if (done && owner) {
+        *owner = result;
+    }
+    return done;
+}
@@ -0,0 +1,31 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSNAMEOWNER_P_H
+#define KDBUSNAMEOWNER_P_H
+
+#include <QDBusConnection>
+#include <QDeadlineTimer>
+#include <QString>
+
+#include <functional>
+
+namespace KDBusNameOwner
+{
+// Blocks until the owner of serviceName satisfies isDone, or the deadline expires. An empty owner
+// means that nobody owns the name. The changes are received by a QDBusServiceWatcher in a thread of
+// its own, so unlike a nested event loop, nothing is dispatched to the calling thread meanwhile.
+// isDone is called from both threads. On success, the owner is stored in owner if given.
+bool waitFor(const QDBusConnection &connection,
+             const QString &serviceName,
+             const std::function<bool(const QString &owner)> &isDone,
+             const QDeadlineTimer &deadline,
+             QString *owner = nullptr);
+}
+
+#endif
@@ -11,11 +11,20 @@
 #include "kdbusservice.h"
 
 #include <QCoreApplication>
+#include <QDeadlineTimer>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMetaMethod>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
 
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
 #include <QDBusReply>
+#include <QDBusUnixFileDescriptor>
 
 #include "FreeDesktopApplpicationIface.h"
 #include "KDBusServiceIface.h"
@@ -27,16 +36,76 @@
 #endif
 
 #include "kdbusaddons_debug.h"
+#include "kdbusaddonstrace_p.h"
+#include "kdbusnameowner_p.h"
 #include "kdbusservice_adaptor.h"
 #include "kdbusserviceextensions_adaptor.h"
+#include "kquitservicejob_p.h"
+#include "mainapplication_adaptor.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+
+#ifdef Q_OS_UNIX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// An activation request waiting in the queue
+struct PendingActivation {
+    enum Type {
+        Activate,
+        Open,
+        ActivateAction,
+    };
+
+    Type type = Activate;
+    QStringList uris;
+    QString actionName;
+    QVariant parameter;
+    QVariantMap platformData;
+    QElapsedTimer waitTimer;
+    qint64 receivedAt = 0;
+};
+
+// How many activation latencies are kept
+static const int s_latencyHistorySize = 256;
+
+// How long a process started by the bus waits for the call it was started for. The bus daemon
+// gives up on starting a service after as long, and so does a caller with the default timeout.
+static const int s_busActivationTimeout = 25000;
+
+// The platform data entry a duplicate instance puts its send time in, on the clock of KDBusAddonsTrace::timestamp()
+static const QLatin1String s_sendTimeKey("x-kde-send-time");
 
 class KDBusServicePrivate
 {
 public:
-    KDBusServicePrivate()
-        : registered(false)
+    KDBusServicePrivate(KDBusService *q_, const QDBusConnection &connection_, bool defaultSessionBus_)
+        : q(q_)
+        , connection(connection_)
+        , defaultSessionBus(defaultSessionBus_)
+        , registered(false)
         , exitValue(0)
     {
+        QObject::connect(&activationTimer, &QTimer::timeout, q, [this]() {
+            processNextActivation();
+        });
+    }
+
+    ~KDBusServicePrivate()
+    {
+#ifdef Q_OS_UNIX
+        if (handoverState) {
+            munmap(const_cast<char *>(handoverState), size_t(handoverStateSize));
+        }
+#endif
     }
 
     QString generateServiceName()
@@ -58,29 +127,630 @@ public:
         return reversedDomain + app->applicationName();
     }
 
-    static void handlePlatformData(const QVariantMap &platformData)
+    void beginActivation(const QVariantMap &platformData)
     {
-        #if HAVE_X11
+        activationContext = KDBusActivationContext(platformData);
+
+#if HAVE_X11
         if (QX11Info::isPlatformX11()) {
-            QByteArray desktopStartupId = platformData.value(QStringLiteral("desktop-startup-id")).toByteArray();
+            const QByteArray desktopStartupId = activationContext.desktopStartupId();
             if (!desktopStartupId.isEmpty()) {
                 QX11Info::setNextStartupId(desktopStartupId);
             }
         }
-        #endif
+#endif
 
-        const auto xdgActivationToken = platformData.value(QLatin1String("activation-token")).toByteArray();
-        if (!xdgActivationToken.isEmpty()) {
+        const QByteArray xdgActivationToken = activationContext.activationToken();
+        if (activationTokenEnvironment && !xdgActivationToken.isEmpty()) {
             qputenv("XDG_ACTIVATION_TOKEN", xdgActivationToken);
+            activationTokenExported = true;
+        }
+    }
+
+    void endActivation()
+    {
+        if (activationTokenExported) {
+            qunsetenv("XDG_ACTIVATION_TOKEN");
+            activationTokenExported = false;
+        }
+        activationContext = KDBusActivationContext();
+    }
+
+    void awaitBusActivation()
+    {
+        awaitingBusActivation = true;
+        // The activating call may arrive late, when the application is slow to reach its event loop
+        // or the bus daemon is loaded. It ends the wait once it arrives, see handleActivation() and
+        // commandLine(). If it went to an interface of the application instead, a later request
+        // would get the head start, so the wait is bounded.
+        QTimer::singleShot(s_busActivationTimeout, q, [this]() {
+            awaitingBusActivation = false;
+        });
+    }
+
+    void handleActivation(PendingActivation &&activation)
+    {
+        activation.receivedAt = KDBusAddonsTrace::timestamp();
+
+        // The call the bus started us for does not wait for the pacing of later requests
+        if (activationQueueLimit <= 0 || (awaitingBusActivation && activationQueue.empty())) {
+            awaitingBusActivation = false;
+            // Requests queued before the limit was lifted still go first
+            while (!activationQueue.empty()) {
+                processNextActivation();
+            }
+            process(activation);
+            return;
+        }
+
+        if (mergePolicy == KDBusService::MergeDuplicateOpen && activation.type == PendingActivation::Open) {
+            QStringList uris;
+            for (const QString &uri : std::as_const(activation.uris)) {
+                if (!pendingUris.contains(uri) && !uris.contains(uri)) {
+                    uris << uri;
+                }
+            }
+            if (uris.isEmpty()) {
+                ++statistics.merged;
+                carryActivationToken(activation);
+                return;
+            }
+            activation.uris = uris;
+        }
+
+        if (int(activationQueue.size()) >= activationQueueLimit) {
+            // The queue is full: the caller only gets its reply once the oldest request was handled
+            processNextActivation();
+        }
+
+        for (const QString &uri : std::as_const(activation.uris)) {
+            pendingUris.insert(uri);
+        }
+        activation.waitTimer.start();
+        activationQueue.push_back(std::move(activation));
+        statistics.peakDepth = std::max(statistics.peakDepth, int(activationQueue.size()));
+
+        if (!activationTimer.isActive()) {
+            activationTimer.start(activationInterval);
+        }
+        updateLoad();
+    }
+
+    // The request merged into a queued one may have been made later by the user, so the queued
+    // entry gets its newer token to raise the window with
+    void carryActivationToken(const PendingActivation &activation)
+    {
+        for (auto it = activationQueue.rbegin(); it != activationQueue.rend(); ++it) {
+            if (it->type != PendingActivation::Open) {
+                continue;
+            }
+            const bool overlaps = std::any_of(activation.uris.cbegin(), activation.uris.cend(), [&it](const QString &uri) {
+                return it->uris.contains(uri);
+            });
+            if (!overlaps) {
+                continue;
+            }
+            for (const QString &key : {QStringLiteral("activation-token"), QStringLiteral("desktop-startup-id")}) {
+                const auto value = activation.platformData.constFind(key);
+                if (value != activation.platformData.cend()) {
+                    it->platformData.insert(key, value.value());
+                }
+            }
+            return;
+        }
+    }
+
+    void processNextActivation()
+    {
+        if (activationQueue.empty()) {
+            activationTimer.stop();
+            return;
+        }
+
+        const PendingActivation activation = std::move(activationQueue.front());
+        activationQueue.pop_front();
+        if (activationQueue.empty()) {
+            activationTimer.stop();
+        }
+
+        for (const QString &uri : activation.uris) {
+            pendingUris.remove(uri);
+        }
+        const qint64 waitTime = activation.waitTimer.elapsed();
+        KDBusAddonsTrace::instantEvent("activation", QStringLiteral("dequeue"), {{QStringLiteral("waitTime"), waitTime}});
+        ++statistics.processed;
+        statistics.totalWaitTime += waitTime;
+        statistics.maxWaitTime = std::max(statistics.maxWaitTime, waitTime);
+        updateLoad();
+
+        process(activation);
+    }
+
+    void process(const PendingActivation &activation)
+    {
+        if (activation.type == PendingActivation::Open && openChunkSize > 0 && activation.uris.size() > openChunkSize) {
+            openInChunks(activation.uris, activation.platformData, openChunkSize, 0);
+            // The user sees a reaction with the first chunk
+            recordLatency(QStringLiteral("Open"), activation.receivedAt, activation.platformData);
+            return;
+        }
+
+        KDBusAddonsTrace::Span span("activation", activationSignalName(activation.type));
+        beginActivation(activation.platformData);
+        switch (activation.type) {
+        case PendingActivation::Activate:
+            Q_EMIT q->activateRequested(QStringList(QCoreApplication::arguments()[0]), QDir::currentPath());
+            break;
+        case PendingActivation::Open:
+            Q_EMIT q->openRequested(QUrl::fromStringList(activation.uris));
+            break;
+        case PendingActivation::ActivateAction:
+            Q_EMIT q->activateActionRequested(activation.actionName, activation.parameter);
+            break;
+        }
+        endActivation();
+        recordLatency(activationMethodName(activation.type), activation.receivedAt, activation.platformData);
+    }
+
+    int commandLine(const QStringList &arguments, const QString &workingDirectory, const QVariantMap &platformData, const QString &method, qint64 receivedAt)
+    {
+        awaitingBusActivation = false;
+        KDBusAddonsTrace::Span span("activation", QStringLiteral("commandLine"));
+        exitValue = 0;
+        beginActivation(platformData);
+        // The TODOs here only make sense if this method can be called from the GUI.
+        // If it's for pure "usage in the terminal" then no startup notification got started.
+        // But maybe one day the workspace wants to call this for the Exec key of a .desktop file?
+        Q_EMIT q->activateRequested(arguments, workingDirectory);
+        endActivation();
+        recordLatency(method, receivedAt, platformData);
+        return exitValue;
+    }
+
+    static QString activationMethodName(PendingActivation::Type type)
+    {
+        switch (type) {
+        case PendingActivation::Activate:
+            return QStringLiteral("Activate");
+        case PendingActivation::Open:
+            return QStringLiteral("Open");
+        case PendingActivation::ActivateAction:
+            return QStringLiteral("ActivateAction");
+        }
+        return QString();
+    }
+
+    void recordLatency(const QString &method, qint64 receivedAt, const QVariantMap &platformData)
+    {
+        const qint64 now = KDBusAddonsTrace::timestamp();
+
+        KDBusService::ActivationLatency latency;
+        latency.method = method;
+        latency.handlingTime = now - receivedAt;
+        bool ok = false;
+        const qint64 sentAt = platformData.value(s_sendTimeKey).toLongLong(&ok);
+        if (ok && sentAt > 0 && sentAt <= receivedAt) {
+            latency.endToEndTime = now - sentAt;
+        }
+
+        if (latencies.size() < s_latencyHistorySize) {
+            latencies.append(latency);
+        } else {
+            latencies[nextLatency] = latency;
         }
+        nextLatency = (nextLatency + 1) % s_latencyHistorySize;
     }
 
+    static QString activationSignalName(PendingActivation::Type type)
+    {
+        switch (type) {
+        case PendingActivation::Activate:
+            return QStringLiteral("activateRequested");
+        case PendingActivation::Open:
+            return QStringLiteral("openRequested");
+        case PendingActivation::ActivateAction:
+            return QStringLiteral("activateActionRequested");
+        }
+        return QString();
+    }
+
+    // Parses and hands out one chunk of URLs per event loop iteration
+    void openInChunks(const QStringList &uris, const QVariantMap &platformData, qsizetype chunkSize, qsizetype offset)
+    {
+        {
+            KDBusAddonsTrace::Span span("activation", QStringLiteral("openRequested"));
+            span.setArgument(QStringLiteral("offset"), qint64(offset));
+            beginActivation(platformData);
+            Q_EMIT q->openRequested(QUrl::fromStringList(uris.mid(offset, chunkSize)));
+            endActivation();
+        }
+
+        offset += chunkSize;
+        if (offset >= uris.size()) {
+            return;
+        }
+
+        // The startup notification is completed by the first chunk
+        QVariantMap remainingPlatformData = platformData;
+        remainingPlatformData.remove(QStringLiteral("activation-token"));
+        remainingPlatformData.remove(QStringLiteral("desktop-startup-id"));
+        QTimer::singleShot(0, q, [this, uris, remainingPlatformData, chunkSize, offset]() {
+            openInChunks(uris, remainingPlatformData, chunkSize, offset);
+        });
+    }
+
+    bool isBusy() const
+    {
+        return busy || (activationQueueLimit > 0 && int(activationQueue.size()) >= activationQueueLimit);
+    }
+
+    // Publishes Busy and PendingActivations of org.kde.KDBusService when they changed
+    void updateLoad()
+    {
+        const bool nowBusy = isBusy();
+        const uint pendingActivations = uint(activationQueue.size());
+        if (nowBusy == publishedBusy && pendingActivations == publishedPendingActivations) {
+            return;
+        }
+        const bool busyChanged = nowBusy != publishedBusy;
+        publishedBusy = nowBusy;
+        publishedPendingActivations = pendingActivations;
+
+        if (registered) {
+            QDBusMessage message = QDBusMessage::createSignal(objectPath, //
+                                                              QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                              QStringLiteral("PropertiesChanged"));
+            const QVariantMap changedProperties{
+                {QStringLiteral("Busy"), nowBusy},
+                {QStringLiteral("PendingActivations"), pendingActivations},
+            };
+            message << QStringLiteral("org.kde.KDBusService") << changedProperties << QStringList();
+            connection.send(message);
+        }
+
+        if (busyChanged) {
+            Q_EMIT q->busyChanged(nowBusy);
+        }
+    }
+
+    void start(KDBusService::StartupOptions options);
+
+    KDBusService *const q;
+    QDBusConnection connection;
+    // Whether no connection was passed to the constructor, which is what bus activation,
+    // desktop files and error messages refer to
+    const bool defaultSessionBus;
     bool registered;
     QString serviceName;
+    QString objectPath;
     QString errorMessage;
     int exitValue;
+    KDBusActivationContext activationContext;
+    bool activationTokenEnvironment = true;
+    bool activationTokenExported = false;
+
+    std::deque<PendingActivation> activationQueue;
+    QSet<QString> pendingUris;
+    QTimer activationTimer;
+    int activationQueueLimit = 0;
+    int activationInterval = 0;
+    KDBusService::ActivationMergePolicy mergePolicy = KDBusService::NoMerge;
+    KDBusService::ActivationQueueStatistics statistics;
+
+    int openChunkSize = 0;
+
+    // Whether we took the name after the bus started us for a call that has not arrived yet
+    bool awaitingBusActivation = false;
+
+    // The shard we are with the Sharded option, and the well-known name if we own it as well
+    int shardIndex = -1;
+    QString shardEntryName;
+
+    // The state mapped from the instance we replaced
+    const char *handoverState = nullptr;
+    qsizetype handoverStateSize = 0;
+
+    // Ring buffer of the most recent activations, nextLatency is the oldest entry once it is full
+    QList<KDBusService::ActivationLatency> latencies;
+    int nextLatency = 0;
+
+    bool busy = false;
+    bool publishedBusy = false;
+    uint publishedPendingActivations = 0;
 };
 
+// How long a secondary instance waits for a running instance that may be hanging
+static const int s_probeTimeout = 1000;
+
+static int s_forwardingTimeout = 0;
+
+static int s_shardLimit = 0;
+static KDBusService::ShardRouting s_shardRouting = KDBusService::RouteByArguments;
+
+// How long to wait for the name of an instance that quits or is gone
+static const int s_registrationTimeout = 8000;
+static const int s_deadOwnerTimeout = 2000;
+
+static bool isProcessAlive(uint pid)
+{
+#if defined(Q_OS_LINUX)
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    // The state follows the command name in parentheses, which may contain parentheses itself
+    const QByteArray line = stat.readAll();
+    const qsizetype end = line.lastIndexOf(')');
+    if (end < 0 || line.size() <= end + 2) {
+        return true;
+    }
+    const char state = line.at(end + 2);
+    return state != 'Z' && state != 'X';
+#elif defined(Q_OS_UNIX)
+    return ::kill(pid_t(pid), 0) == 0 || errno == EPERM;
+#else
+    Q_UNUSED(pid)
+    return true;
+#endif
+}
+
+// Argument lists bigger than this are handed over in a memfd rather than in the message
+static const int s_fdPassingThreshold = 64 * 1024;
+
+// Writes data into a sealed memory file, which the receiving side can map without copying
+static QDBusUnixFileDescriptor sealedMemoryFile(const char *name, const QByteArray &data)
+{
+#if HAVE_MEMFD
+    const int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return QDBusUnixFileDescriptor();
+    }
+    qsizetype written = 0;
+    while (written < data.size()) {
+        const ssize_t result = ::write(fd, data.constData() + written, data.size() - written);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        } else if (result <= 0) {
+            ::close(fd);
+            return QDBusUnixFileDescriptor();
+        }
+        written += result;
+    }
+    // The receiving side maps the file, it must not change size or content anymore
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        ::close(fd);
+        return QDBusUnixFileDescriptor();
+    }
+
+    QDBusUnixFileDescriptor descriptor;
+    descriptor.giveFileDescriptor(fd);
+    return descriptor;
+#else
+    Q_UNUSED(name)
+    Q_UNUSED(data)
+    return QDBusUnixFileDescriptor();
+#endif
+}
+
+// Maps a file written by sealedMemoryFile() read-only, to be released with munmap().
+// Returns false if the file could still change while it is mapped.
+static bool mapSealedMemoryFile(const QDBusUnixFileDescriptor &descriptor, const char **data, qsizetype *size)
+{
+#ifdef Q_OS_UNIX
+    if (!descriptor.isValid()) {
+        return false;
+    }
+    const int fd = descriptor.fileDescriptor();
+
+#if HAVE_MEMFD
+    // A file that can still shrink could fault us while it is mapped
+    const int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE)) {
+        return false;
+    }
+#endif
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        return false;
+    }
+    *size = qsizetype(info.st_size);
+    if (info.st_size == 0) {
+        *data = nullptr;
+        return true;
+    }
+
+    void *map = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    *data = static_cast<const char *>(map);
+    return true;
+#else
+    Q_UNUSED(descriptor)
+    Q_UNUSED(data)
+    Q_UNUSED(size)
+    return false;
+#endif
+}
+
+static QDBusUnixFileDescriptor largeArgumentsDescriptor(const QDBusConnection &connection, const QStringList &arguments)
+{
+#if HAVE_MEMFD
+    if (!(connection.connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing)) {
+        return QDBusUnixFileDescriptor();
+    }
+
+    bool ok = false;
+    int threshold = qEnvironmentVariableIntValue("KDBUSADDONS_FD_PASSING_THRESHOLD", &ok);
+    if (!ok) {
+        threshold = s_fdPassingThreshold;
+    }
+    qsizetype size = 0;
+    for (const QString &argument : arguments) {
+        size += argument.size() + 1;
+    }
+    if (threshold <= 0 || size < threshold) {
+        return QDBusUnixFileDescriptor();
+    }
+
+    // The arguments are stored NUL-terminated, one after the other
+    QByteArray data;
+    data.reserve(size);
+    for (const QString &argument : arguments) {
+        data += argument.toUtf8();
+        data += '\0';
+    }
+    return sealedMemoryFile("kdbusservice-arguments", data);
+#else
+    Q_UNUSED(connection)
+    Q_UNUSED(arguments)
+    return QDBusUnixFileDescriptor();
+#endif
+}
+
+// Parses the arguments written by largeArgumentsDescriptor() straight from the mapped file
+static bool readArgumentsDescriptor(const QDBusUnixFileDescriptor &descriptor, QStringList *arguments)
+{
+#ifdef Q_OS_UNIX
+    const char *map = nullptr;
+    qsizetype size = 0;
+    if (!mapSealedMemoryFile(descriptor, &map, &size)) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+
+    const char *data = map;
+    const char *const end = map + size;
+    while (data < end) {
+        const char *terminator = static_cast<const char *>(memchr(data, '\0', end - data));
+        if (!terminator) {
+            terminator = end;
+        }
+        arguments->append(QString::fromUtf8(data, terminator - data));
+        data = terminator + 1;
+    }
+    munmap(const_cast<char *>(map), size_t(size));
+    return true;
+#else
+    Q_UNUSED(descriptor)
+    Q_UNUSED(arguments)
+    return false;
+#endif
+}
+
+static QString objectPathForService(const QString &serviceName)
+{
+    QString objectPath = QLatin1Char('/') + serviceName;
+    objectPath.replace(QLatin1Char('.'), QLatin1Char('/'));
+    objectPath.replace(QLatin1Char('-'), QLatin1Char('_')); // see spec change at https://bugs.freedesktop.org/show_bug.cgi?id=95129
+    return objectPath;
+}
+
+// Whether the bus daemon started this process through a .service file, to deliver a call to our
+// name. A child process inherits the variables as well, so this is only a hint: it must never be
+// the reason to behave differently when the name turns out to be taken.
+static bool isStartedByBus()
+{
+    static const bool startedByBus = qgetenv("DBUS_STARTER_BUS_TYPE") == "session" && qEnvironmentVariableIsSet("DBUS_STARTER_ADDRESS");
+    return startedByBus;
+}
+
+// libdbus answers Peer.Ping itself, independent of the event loop of the running instance,
+// so this quickly tells a stopped or dead process apart from one that is just slow
+static bool isServiceResponsive(const QDBusConnection &connection, const QString &serviceName)
+{
+    KDBusAddonsTrace::Span span("registration", QStringLiteral("probe Ping"));
+    const QDBusMessage message = QDBusMessage::createMethodCall(serviceName, //
+                                                                QStringLiteral("/"),
+                                                                QStringLiteral("org.freedesktop.DBus.Peer"),
+                                                                QStringLiteral("Ping"));
+    const QDBusMessage reply = connection.call(message, QDBus::Block, s_probeTimeout);
+    return reply.type() == QDBusMessage::ReplyMessage;
+}
+
+enum class InstanceState {
+    Idle,
+    Busy,
+    Unresponsive,
+};
+
+// Asks the instance owning serviceName for its load, with a short deadline since it may be stuck.
+// An instance whose event loop does not answer in time counts as busy.
+static InstanceState probeInstance(const QDBusConnection &connection, const QString &serviceName, const QString &objectPath)
+{
+    if (!isServiceResponsive(connection, serviceName)) {
+        return InstanceState::Unresponsive;
+    }
+
+    KDBusAddonsTrace::Span span("registration", QStringLiteral("probe Busy"));
+    QDBusMessage message = QDBusMessage::createMethodCall(serviceName, //
+                                                          objectPath,
+                                                          QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                          QStringLiteral("Get"));
+    message << QStringLiteral("org.kde.KDBusService") << QStringLiteral("Busy");
+    const QDBusReply<QVariant> reply = connection.call(message, QDBus::Block, s_probeTimeout);
+    if (!reply.isValid()) {
+        // An instance older than the Busy property answers with an error right away
+        const QDBusError::ErrorType error = reply.error().type();
+        return error == QDBusError::NoReply || error == QDBusError::Timeout ? InstanceState::Busy : InstanceState::Idle;
+    }
+    return reply.value().toBool() ? InstanceState::Busy : InstanceState::Idle;
+}
+
+// Hands the arguments over to the instance owning serviceName, returns whether it took them
+static bool forwardArguments(const QDBusConnection &connection,
+                             const QString &serviceName,
+                             const QString &objectPath,
+                             const QStringList &arguments,
+                             QVariantMap platformData,
+                             int *exitValue,
+                             QString *errorMessage)
+{
+    if (qEnvironmentVariableIsSet("XDG_ACTIVATION_TOKEN")) {
+        platformData.insert(QStringLiteral("activation-token"), qgetenv("XDG_ACTIVATION_TOKEN"));
+    }
+
+    // Lets the running instance measure the latency users see
+    platformData.insert(s_sendTimeKey, KDBusAddonsTrace::timestamp());
+
+    if (arguments.count() > 1) {
+        KDBusAddonsTrace::Span span("forwarding", QStringLiteral("CommandLine"));
+        OrgKdeKDBusServiceInterface iface(serviceName, objectPath, connection);
+        iface.setTimeout(KDBusService::forwardingTimeout()); // Application can take time to answer
+        QDBusReply<int> reply;
+        const QDBusUnixFileDescriptor argumentsDescriptor = largeArgumentsDescriptor(connection, arguments);
+        if (argumentsDescriptor.isValid()) {
+            span.setArgument(QStringLiteral("fd"), true);
+            reply = iface.CommandLineFd(argumentsDescriptor, QDir::currentPath(), platformData);
+            if (!reply.isValid() && reply.error().type() == QDBusError::UnknownMethod) {
+                // The running instance is older than us
+                reply = iface.CommandLine(arguments, QDir::currentPath(), platformData);
+            }
+        } else {
+            reply = iface.CommandLine(arguments, QDir::currentPath(), platformData);
+        }
+        if (!reply.isValid()) {
+            *errorMessage = reply.error().message();
+            return false;
+        }
+        *exitValue = reply.value();
+    } else {
+        KDBusAddonsTrace::Span span("forwarding", QStringLiteral("Activate"));
+        OrgFreedesktopApplicationInterface iface(serviceName, objectPath, connection);
+        iface.setTimeout(KDBusService::forwardingTimeout()); // Application can take time to answer
+        QDBusReply<void> reply = iface.Activate(platformData);
+        if (!reply.isValid()) {
+            *errorMessage = reply.error().message();
+            return false;
+        }
+        *exitValue = 0;
+    }
+    return true;
+}
+
 // Wraps a serviceName registration.
 class Registration : public QObject
 {
@@ -91,10 +761,14 @@ public:
         , d(d_)
         , options(options_)
     {
-        if (!QDBusConnection::sessionBus().isConnected() || !(bus = QDBusConnection::sessionBus().interface())) {
-            d->errorMessage = QLatin1String(
-                "DBus session bus not found. To circumvent this problem try the following command (with bash):\n"
-                "    export $(dbus-launch)");
+        if (!d->connection.isConnected() || !(bus = d->connection.interface())) {
+            if (d->defaultSessionBus) {
+                d->errorMessage = QLatin1String(
+                    "DBus session bus not found. To circumvent this problem try the following command (with bash):\n"
+                    "    export $(dbus-launch)");
+            } else {
+                d->errorMessage = QLatin1String("DBus connection '") + d->connection.name() + QLatin1String("' is not connected");
+            }
         } else {
             generateServiceName();
         }
@@ -116,48 +790,74 @@ private:
     void generateServiceName()
     {
         d->serviceName = d->generateServiceName();
-        objectPath = QLatin1Char('/') + d->serviceName;
-        objectPath.replace(QLatin1Char('.'), QLatin1Char('/'));
-        objectPath.replace(QLatin1Char('-'), QLatin1Char('_')); // see spec change at https://bugs.freedesktop.org/show_bug.cgi?id=95129
+        d->objectPath = objectPathForService(d->serviceName);
 
         if (options & KDBusService::Multiple) {
-            const bool inSandbox = QFileInfo::exists(QStringLiteral("/.flatpak-info"));
-            if (inSandbox) {
-                d->serviceName += QStringLiteral(".kdbus-")
-                    + QDBusConnection::sessionBus().baseService().replace(QRegularExpression(QStringLiteral("[\\.:]")), QStringLiteral("_"));
-            } else {
-                d->serviceName += QLatin1Char('-') + QString::number(QCoreApplication::applicationPid());
-            }
+            d->serviceName = multipleServiceName(d->serviceName);
         }
     }
 
+    QString multipleServiceName(const QString &serviceName) const
+    {
+        const bool inSandbox = QFileInfo::exists(QStringLiteral("/.flatpak-info"));
+        if (inSandbox) {
+            return serviceName + QStringLiteral(".kdbus-")
+                + d->connection.baseService().replace(QRegularExpression(QStringLiteral("[\\.:]")), QStringLiteral("_"));
+        }
+        return serviceName + QLatin1Char('-') + QString::number(QCoreApplication::applicationPid());
+    }
+
     void registerOnBus()
     {
-        auto bus = QDBusConnection::sessionBus();
+        if (registerObjects()) {
+            attemptRegistration();
+        }
+    }
+
+    bool registerObjects()
+    {
+        KDBusAddonsTrace::Span span("registration", QStringLiteral("registerObject"));
+        auto bus = d->connection;
         bool objectRegistered = false;
-        objectRegistered = bus.registerObject(QStringLiteral("/MainApplication"),
-                                              QCoreApplication::instance(),
-                                              QDBusConnection::ExportAllSlots //
-                                                  | QDBusConnection::ExportScriptableProperties //
-                                                  | QDBusConnection::ExportAdaptors);
+        QCoreApplication *app = QCoreApplication::instance();
+        if (options & KDBusService::MinimalMainApplication) {
+            // The adaptor brings its introspection data along, generated at build time
+            if (!app->findChild<MainApplicationAdaptor *>(QString(), Qt::FindDirectChildrenOnly)) {
+                new MainApplicationAdaptor(app);
+            }
+            objectRegistered = bus.registerObject(QStringLiteral("/MainApplication"), app, QDBusConnection::ExportAdaptors);
+        } else {
+            objectRegistered = bus.registerObject(QStringLiteral("/MainApplication"),
+                                                  app,
+                                                  QDBusConnection::ExportAllSlots //
+                                                      | QDBusConnection::ExportScriptableProperties //
+                                                      | QDBusConnection::ExportAdaptors);
+        }
         if (!objectRegistered) {
             qCWarning(KDBUSADDONS_LOG) << "Failed to register /MainApplication on DBus";
-            return;
+            return false;
         }
 
-        objectRegistered = bus.registerObject(objectPath, s, QDBusConnection::ExportAdaptors);
+        objectRegistered = bus.registerObject(d->objectPath, s, QDBusConnection::ExportAdaptors);
         if (!objectRegistered) {
-            qCWarning(KDBUSADDONS_LOG) << "Failed to register" << objectPath << "on DBus";
-            return;
+            qCWarning(KDBUSADDONS_LOG) << "Failed to register" << d->objectPath << "on DBus";
+            return false;
         }
-
-        attemptRegistration();
+        return true;
     }
 
     void attemptRegistration()
     {
         Q_ASSERT(!d->registered);
 
+        if (options & KDBusService::Sharded) {
+            attemptShardedRegistration();
+            if (!d->registered) {
+                d->errorMessage = QLatin1String("Failed to register a shard of '") + d->serviceName + QLatin1String("' with DBUS");
+            }
+            return;
+        }
+
         auto queueOption = QDBusConnectionInterface::DontQueueService;
 
         if (options & KDBusService::Unique) {
@@ -169,72 +869,82 @@ private:
             // become registered.
 
             queueOption = QDBusConnectionInterface::QueueService;
+        }
 
-            connect(bus, &QDBusConnectionInterface::serviceRegistered, this, [this](const QString &service) {
-                if (service != d->serviceName) {
-                    return;
-                }
-
-                d->registered = true;
-                registrationLoop.quit();
-            });
+        // Queued, the running instance can tell that we are the one replacing it,
+        // and the name passes to us as soon as it lets go of it
+        if (options & KDBusService::Replace) {
+            queueOption = QDBusConnectionInterface::QueueService;
         }
 
-        d->registered = (bus->registerService(d->serviceName, queueOption) == QDBusConnectionInterface::ServiceRegistered);
+        // The name of a Multiple instance is not the one the bus was asked for
+        const bool startedByBus = !(options & KDBusService::Multiple) && isStartedByBus() && d->defaultSessionBus;
+
+        {
+            KDBusAddonsTrace::Span span("registration", QStringLiteral("RequestName"));
+            span.setArgument(QStringLiteral("name"), d->serviceName);
+            span.setArgument(QStringLiteral("startedByBus"), startedByBus);
+            d->registered = (bus->registerService(d->serviceName, queueOption) == QDBusConnectionInterface::ServiceRegistered);
+        }
 
         if (d->registered) {
+            if (startedByBus) {
+                // A caller is waiting for the name, its call is the first to handle
+                d->awaitBusActivation();
+            }
             return;
         }
 
         if (options & KDBusService::Replace) {
-            auto message = QDBusMessage::createMethodCall(d->serviceName,
-                                                          QStringLiteral("/MainApplication"),
-                                                          QStringLiteral("org.qtproject.Qt.QCoreApplication"),
-                                                          QStringLiteral("quit"));
-            QDBusConnection::sessionBus().asyncCall(message);
-            waitForRegistration();
-        } else if (options & KDBusService::Unique) {
-            // Already running so it's ok!
-            QVariantMap platform_data;
-#if HAVE_X11
-            if (QX11Info::isPlatformX11()) {
-                QString startupId = QString::fromUtf8(qgetenv("DESKTOP_STARTUP_ID"));
-                if (startupId.isEmpty()) {
-                    startupId = QString::fromUtf8(QX11Info::nextStartupId());
-                }
-                if (!startupId.isEmpty()) {
-                    platform_data.insert(QStringLiteral("desktop-startup-id"), startupId);
+            KDBusAddonsTrace::Span span("registration", QStringLiteral("replace"));
+            const QDeadlineTimer deadline(s_registrationTimeout);
+            // The running instance releases the name when it hands over its state,
+            // from then on it can only be reached through its unique name
+            const QDBusReply<QString> owner = bus->serviceOwner(d->serviceName);
+            if (owner.isValid()) {
+                receiveHandoverState(owner.value(), deadline);
+                const QDBusError error = KQuitServiceJobPrivate::quitAndWaitForRelease(d->connection,
+                                                                                      d->serviceName,
+                                                                                      owner.value(),
+                                                                                      QStringLiteral("/MainApplication"),
+                                                                                      QStringLiteral("org.qtproject.Qt.QCoreApplication"),
+                                                                                      deadline);
+                if (error.isValid()) {
+                    qCDebug(KDBUSADDONS_LOG) << "The running instance did not quit:" << error.message();
                 }
             }
-#endif
-
-            if (qEnvironmentVariableIsSet("XDG_ACTIVATION_TOKEN")) {
-                platform_data.insert(QStringLiteral("activation-token"), qgetenv("XDG_ACTIVATION_TOKEN"));
+            if (!waitForRegistration(deadline, queueOption)) {
+                // Do not stay queued for a name we gave up on
+                bus->unregisterService(d->serviceName);
+            }
+        } else if (options & KDBusService::Unique) {
+            if (isRunningInstanceDead() && waitForRegistration(QDeadlineTimer(s_deadOwnerTimeout), queueOption)) {
+                qCDebug(KDBUSADDONS_LOG) << "Took over" << d->serviceName << "from an instance that is gone";
+                return;
             }
 
-            if (QCoreApplication::arguments().count() > 1) {
-                OrgKdeKDBusServiceInterface iface(d->serviceName, objectPath, QDBusConnection::sessionBus());
-                iface.setTimeout(5 * 60 * 1000); // Application can take time to answer
-                QDBusReply<int> reply = iface.CommandLine(QCoreApplication::arguments(), QDir::currentPath(), platform_data);
-                if (reply.isValid()) {
-                    exit(reply.value());
-                } else {
-                    d->errorMessage = reply.error().message();
+            // Already running so it's ok!
+            bool responsive = false;
+            if (options & KDBusService::MultipleWhenBusy) {
+                const InstanceState state = probeInstance(d->connection, d->serviceName, d->objectPath);
+                if (state != InstanceState::Idle && registerStandalone()) {
+                    qCDebug(KDBUSADDONS_LOG) << "The running instance is busy or does not respond, registered as" << d->serviceName;
+                    return;
                 }
+                responsive = state != InstanceState::Unresponsive;
             } else {
-                OrgFreedesktopApplicationInterface iface(d->serviceName, objectPath, QDBusConnection::sessionBus());
-                iface.setTimeout(5 * 60 * 1000); // Application can take time to answer
-                QDBusReply<void> reply = iface.Activate(platform_data);
-                if (reply.isValid()) {
-                    exit(0);
-                } else {
-                    d->errorMessage = reply.error().message();
-                }
+                // A slow instance still gets the arguments, it handles them once it recovers
+                responsive = isServiceResponsive(d->connection, d->serviceName);
+            }
+            if (responsive) {
+                forwardToRunningInstance(d->serviceName);
+            } else {
+                qCWarning(KDBUSADDONS_LOG) << "The running instance of" << d->serviceName << "does not respond";
             }
 
             // service did not respond in a valid way....
             // let's wait to see if our queued registration finishes perhaps.
-            waitForRegistration();
+            waitForRegistration(QDeadlineTimer(s_registrationTimeout), queueOption);
         }
 
         if (!d->registered) { // either multi service or failed to reclaim name
@@ -242,32 +952,255 @@ private:
         }
     }
 
-    void waitForRegistration()
+    // Hands our arguments over to the running instance and exits, unless that fails
+    void forwardToRunningInstance(const QString &serviceName)
+    {
+        QVariantMap platform_data;
+#if HAVE_X11
+        if (QX11Info::isPlatformX11()) {
+            QString startupId = QString::fromUtf8(qgetenv("DESKTOP_STARTUP_ID"));
+            if (startupId.isEmpty()) {
+                startupId = QString::fromUtf8(QX11Info::nextStartupId());
+            }
+            if (!startupId.isEmpty()) {
+                platform_data.insert(QStringLiteral("desktop-startup-id"), startupId);
+            }
+        }
+#endif
+
+        int exitValue = 0;
+        if (forwardArguments(d->connection, serviceName, d->objectPath, QCoreApplication::arguments(), platform_data, &exitValue, &d->errorMessage)) {
+            exit(exitValue);
+        }
+    }
+
+    // Registers as the shard our arguments belong to, or hands them over to that shard and exits
+    void attemptShardedRegistration()
+    {
+        const QString entryName = d->serviceName;
+        const int limit = KDBusService::shardLimit();
+        int stuckIndex = -1;
+        // Another instance may take or release a shard name at the same time, so try twice.
+        // The routing would choose a shard that did not take our arguments again, so the
+        // second attempt goes to the least loaded of the others.
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            const int index = attempt == 0 ? selectShard(entryName, limit) : leastLoadedShard(entryName, limit, stuckIndex);
+            if (index < 0) {
+                break;
+            }
+            const QString shardName = shardServiceName(entryName, index);
+            if (bus->registerService(shardName, QDBusConnectionInterface::DontQueueService) == QDBusConnectionInterface::ServiceRegistered) {
+                d->serviceName = shardName;
+                d->shardIndex = index;
+                d->registered = true;
+                // Every shard queues for the well-known name, like for D-Bus activation, so that
+                // it passes on to a remaining shard when the one holding it exits
+                bus->registerService(entryName, QDBusConnectionInterface::QueueService);
+                d->shardEntryName = entryName;
+                return;
+            }
+            // Like MultipleWhenBusy, a shard that is busy would only sit on our arguments
+            if (probeInstance(d->connection, shardName, d->objectPath) == InstanceState::Idle) {
+                forwardToRunningInstance(shardName);
+            }
+            stuckIndex = index;
+        }
+
+        // All shards are taken and do not respond, run on our own rather than fail
+        d->serviceName = multipleServiceName(entryName);
+        d->registered = (bus->registerService(d->serviceName, QDBusConnectionInterface::DontQueueService) == QDBusConnectionInterface::ServiceRegistered);
+        if (d->registered) {
+            qCDebug(KDBUSADDONS_LOG) << "No shard of" << entryName << "takes requests, registered as" << d->serviceName;
+        }
+    }
+
+    static QString shardServiceName(const QString &entryName, int index)
     {
-        QTimer quitTimer;
-        // We have to wait for the other application to quit completely which could take a while
-        quitTimer.start(8000);
-        connect(&quitTimer, &QTimer::timeout, &registrationLoop, &QEventLoop::quit);
-        registrationLoop.exec();
+        return entryName + QStringLiteral(".shard-") + QString::number(index);
+    }
+
+    // The arguments that are not options, like the documents to open. Which options take a
+    // value is up to the application's parser, so a value given as a separate argument
+    // ("--geometry 800x600") cannot be told apart from a document and is routed like one.
+    static QStringList routingArguments()
+    {
+        const QStringList allArguments = QCoreApplication::arguments().mid(1);
+        QStringList arguments;
+        for (auto it = allArguments.cbegin(); it != allArguments.cend(); ++it) {
+            if (*it == QLatin1String("--")) {
+                // Everything after it is positional, even if it starts with a dash
+                arguments.append(QStringList(std::next(it), allArguments.cend()));
+                break;
+            }
+            if (!it->startsWith(QLatin1Char('-'))) {
+                arguments.append(*it);
+            }
+        }
+        return arguments;
+    }
+
+    int selectShard(const QString &entryName, int limit) const
+    {
+        const QStringList arguments = routingArguments();
+        if (arguments.isEmpty() || KDBusService::shardRouting() == KDBusService::RouteToLeastLoaded) {
+            return leastLoadedShard(entryName, limit);
+        }
+
+        QString key = arguments.join(QLatin1Char('\n'));
+        if (KDBusService::shardRouting() == KDBusService::RouteByUrlHost) {
+            const QString host = QUrl::fromUserInput(arguments.constFirst(), QDir::currentPath(), QUrl::AssumeLocalFile).host();
+            // Local files have no host, they are spread by their names instead
+            if (!host.isEmpty()) {
+                key = host;
+            }
+        }
+        // Every instance has to arrive at the same shard, so the hash must not be seeded randomly
+        return int(qHash(key, 0) % uint(limit));
+    }
+
+    // Prefers an idle shard, then a new one, then the one with the shortest activation queue.
+    // Returns -1 if all shards are taken and none of them responds.
+    int leastLoadedShard(const QString &entryName, int limit, int excludedIndex = -1) const
+    {
+        const QStringList names = bus->registeredServiceNames().value();
+        int freeIndex = -1;
+        int bestIndex = -1;
+        qint64 bestLoad = std::numeric_limits<qint64>::max();
+        for (int index = 0; index < limit; ++index) {
+            if (index == excludedIndex) {
+                continue;
+            }
+            const QString shardName = shardServiceName(entryName, index);
+            if (!names.contains(shardName)) {
+                if (freeIndex < 0) {
+                    freeIndex = index;
+                }
+                continue;
+            }
+
+            QDBusMessage message = QDBusMessage::createMethodCall(shardName, //
+                                                                  d->objectPath,
+                                                                  QStringLiteral("org.freedesktop.DBus.Properties"),
+                                                                  QStringLiteral("GetAll"));
+            message << QStringLiteral("org.kde.KDBusService");
+            const QDBusReply<QVariantMap> reply = d->connection.call(message, QDBus::Block, s_probeTimeout);
+            if (!reply.isValid()) {
+                continue; // not responding, do not send anything there
+            }
+            const QVariantMap properties = reply.value();
+            const qint64 load = properties.value(QStringLiteral("Busy")).toBool() ? std::numeric_limits<int>::max()
+                                                                                   : properties.value(QStringLiteral("PendingActivations")).toLongLong();
+            if (load < bestLoad) {
+                bestLoad = load;
+                bestIndex = index;
+            }
+        }
+
+        if (bestIndex < 0 || (bestLoad > 0 && freeIndex >= 0)) {
+            return freeIndex;
+        }
+        return bestIndex;
+    }
+
+    // Asks the running instance for its state, it releases the name once it has handed it over
+    void receiveHandoverState(const QString &owner, const QDeadlineTimer &deadline)
+    {
+        if (!(d->connection.connectionCapabilities() & QDBusConnection::UnixFileDescriptorPassing)) {
+            return;
+        }
+
+        KDBusAddonsTrace::Span span("registration", QStringLiteral("handover"));
+        const QDBusMessage message = QDBusMessage::createMethodCall(owner, //
+                                                                    d->objectPath,
+                                                                    QStringLiteral("org.kde.KDBusService"),
+                                                                    QStringLiteral("Handover"));
+        const QDBusReply<QDBusUnixFileDescriptor> reply = d->connection.call(message, QDBus::Block, int(deadline.remainingTime()));
+        if (!reply.isValid()) {
+            qCDebug(KDBUSADDONS_LOG) << "The running instance did not hand over its state:" << reply.error().message();
+            return;
+        }
+        if (!mapSealedMemoryFile(reply.value(), &d->handoverState, &d->handoverStateSize)) {
+            qCWarning(KDBUSADDONS_LOG) << "Could not map the state handed over by the running instance";
+            d->handoverState = nullptr;
+            d->handoverStateSize = 0;
+        }
+    }
+
+    // When a process crashes and gets auto-restarted by KCrash, the old
+    // process may still hold the name while it is already dead or a zombie.
+    bool isRunningInstanceDead() const
+    {
+        if (QFileInfo::exists(QStringLiteral("/.flatpak-info"))) {
+            return false; // the bus reports host PIDs, which we cannot see from inside the sandbox
+        }
+        KDBusAddonsTrace::Span span("registration", QStringLiteral("probe owner pid"));
+        const QDBusReply<uint> pid = bus->servicePid(d->serviceName);
+        return pid.isValid() && !isProcessAlive(pid.value());
+    }
+
+    // Waits until the name is ours. No events are dispatched to this thread meanwhile, so the
+    // application, which is still being set up, cannot be reentered.
+    bool waitForRegistration(const QDeadlineTimer &deadline, QDBusConnectionInterface::ServiceQueueOptions queueOption)
+    {
+        KDBusAddonsTrace::Span span("registration", QStringLiteral("wait for name"));
+        const QString baseService = d->connection.baseService();
+        // Without a queued request the released name has to be requested again
+        const bool queued = queueOption == QDBusConnectionInterface::QueueService;
+        const auto isDone = [baseService, queued](const QString &owner) {
+            return owner == baseService || (!queued && owner.isEmpty());
+        };
+        QString owner;
+        while (!deadline.hasExpired() && KDBusNameOwner::waitFor(d->connection, d->serviceName, isDone, deadline, &owner)) {
+            if (owner == baseService) {
+                d->registered = true;
+                return true;
+            }
+            d->registered = (bus->registerService(d->serviceName, queueOption) == QDBusConnectionInterface::ServiceRegistered);
+            if (d->registered) {
+                return true;
+            }
+        }
+        qCDebug(KDBUSADDONS_LOG) << "Timed out waiting for the name" << d->serviceName;
+        span.setArgument(QStringLiteral("timedOut"), true);
+        return false;
+    }
+
+    // Gives up on the unique name and registers like a Multiple instance instead
+    bool registerStandalone()
+    {
+        bus->unregisterService(d->serviceName); // leaves the queue for the unique name
+        d->serviceName = multipleServiceName(d->serviceName);
+        d->registered = (bus->registerService(d->serviceName, QDBusConnectionInterface::DontQueueService) == QDBusConnectionInterface::ServiceRegistered);
+        return d->registered;
     }
 
     QDBusConnectionInterface *bus = nullptr;
     KDBusService *s = nullptr;
     KDBusServicePrivate *d = nullptr;
     KDBusService::StartupOptions options;
-    QEventLoop registrationLoop;
-    QString objectPath;
 };
 
+void KDBusServicePrivate::start(KDBusService::StartupOptions options)
+{
+    new KDBusServiceAdaptor(q);
+    new KDBusServiceExtensionsAdaptor(q);
+
+    Registration registration(q, this, options);
+    registration.run();
+}
+
 KDBusService::KDBusService(StartupOptions options, QObject *parent)
     : QObject(parent)
-    , d(new KDBusServicePrivate)
+    , d(new KDBusServicePrivate(this, QDBusConnection::sessionBus(), true))
 {
-    new KDBusServiceAdaptor(this);
-    new KDBusServiceExtensionsAdaptor(this);
+    d->start(options);
+}
 
-    Registration registration(this, d.get(), options);
-    registration.run();
+KDBusService::KDBusService(StartupOptions options, const QDBusConnection &connection, QObject *parent)
+    : QObject(parent)
+    , d(new KDBusServicePrivate(this, connection, false))
+{
+    d->start(options);
 }
 
 KDBusService::~KDBusService() = default;
@@ -287,6 +1220,192 @@ void KDBusService::setExitValue(int value)
     d->exitValue = value;
 }
 
+void KDBusService::setForwardingTimeout(int msecs)
+{
+    s_forwardingTimeout = msecs;
+}
+
+int KDBusService::forwardingTimeout()
+{
+    bool ok = false;
+    const int timeout = qEnvironmentVariableIntValue("KDBUSADDONS_FORWARDING_TIMEOUT", &ok);
+    if (ok && timeout > 0) {
+        return timeout;
+    }
+    return s_forwardingTimeout > 0 ? s_forwardingTimeout : 5 * 60 * 1000;
+}
+
+void KDBusService::setShardLimit(int limit)
+{
+    s_shardLimit = limit;
+}
+
+int KDBusService::shardLimit()
+{
+    return s_shardLimit > 0 ? s_shardLimit : std::max(1, QThread::idealThreadCount());
+}
+
+void KDBusService::setShardRouting(ShardRouting routing)
+{
+    s_shardRouting = routing;
+}
+
+KDBusService::ShardRouting KDBusService::shardRouting()
+{
+    return s_shardRouting;
+}
+
+int KDBusService::shardIndex() const
+{
+    return d->shardIndex;
+}
+
+QByteArray KDBusService::handoverState() const
+{
+    return QByteArray::fromRawData(d->handoverState, d->handoverStateSize);
+}
+
+std::optional<int> KDBusService::forwardIfRunning(int argc, char **argv, const QString &serviceName)
+{
+    // Started by the bus, the name had no owner a moment ago, so probing for one only costs time
+    if (isStartedByBus()) {
+        return std::nullopt;
+    }
+
+    // Without a QCoreApplication the shared session bus connection must not be used yet
+    const QString connectionName = QStringLiteral("kdbusservice-forward");
+    std::optional<int> result;
+    {
+        const QDBusConnection connection = QDBusConnection::connectToBus(QDBusConnection::SessionBus, connectionName);
+        QDBusConnectionInterface *bus = connection.isConnected() ? connection.interface() : nullptr;
+        // A running instance that is busy or does not respond is left to the regular registration,
+        // which knows the startup options and how long to wait
+        if (bus && bus->isServiceRegistered(serviceName)
+            && probeInstance(connection, serviceName, objectPathForService(serviceName)) == InstanceState::Idle) {
+            QStringList arguments;
+            arguments.reserve(argc);
+            for (int i = 0; i < argc; ++i) {
+                arguments << QString::fromLocal8Bit(argv[i]);
+            }
+
+            QVariantMap platformData;
+            const QByteArray startupId = qgetenv("DESKTOP_STARTUP_ID");
+            if (!startupId.isEmpty()) {
+                platformData.insert(QStringLiteral("desktop-startup-id"), QString::fromUtf8(startupId));
+            }
+
+            int exitValue = 0;
+            QString errorMessage;
+            if (forwardArguments(connection, serviceName, objectPathForService(serviceName), arguments, platformData, &exitValue, &errorMessage)) {
+                result = exitValue;
+            } else {
+                qCDebug(KDBUSADDONS_LOG) << "Could not forward to" << serviceName << errorMessage;
+            }
+        }
+    }
+    QDBusConnection::disconnectFromBus(connectionName);
+    return result;
+}
+
+void KDBusService::prepareSessionBus()
+{
+    // QtDBus serializes the creation of the shared connection, so a sessionBus()
+    // call on the main thread meanwhile simply waits for this one
+    QThreadPool::globalInstance()->start([]() {
+        KDBusAddonsTrace::Span span("registration", QStringLiteral("prepare session bus"));
+        QDBusConnection::sessionBus();
+    });
+}
+
+KDBusActivationContext KDBusService::activationContext() const
+{
+    return d->activationContext;
+}
+
+void KDBusService::setActivationTokenEnvironmentEnabled(bool enabled)
+{
+    d->activationTokenEnvironment = enabled;
+}
+
+bool KDBusService::isActivationTokenEnvironmentEnabled() const
+{
+    return d->activationTokenEnvironment;
+}
+
+void KDBusService::setActivationQueueLimit(int limit)
+{
+    d->activationQueueLimit = limit;
+    // Lowering the limit must not strand requests that are already queued
+    if (limit <= 0 && !d->activationQueue.empty() && !d->activationTimer.isActive()) {
+        d->activationTimer.start(d->activationInterval);
+    }
+    d->updateLoad();
+}
+
+int KDBusService::activationQueueLimit() const
+{
+    return d->activationQueueLimit;
+}
+
+void KDBusService::setActivationInterval(int msecs)
+{
+    d->activationInterval = msecs;
+    d->activationTimer.setInterval(msecs);
+}
+
+int KDBusService::activationInterval() const
+{
+    return d->activationInterval;
+}
+
+void KDBusService::setActivationMergePolicy(ActivationMergePolicy policy)
+{
+    d->mergePolicy = policy;
+}
+
+KDBusService::ActivationMergePolicy KDBusService::activationMergePolicy() const
+{
+    return d->mergePolicy;
+}
+
+KDBusService::ActivationQueueStatistics KDBusService::activationQueueStatistics() const
+{
+    ActivationQueueStatistics statistics = d->statistics;
+    statistics.depth = int(d->activationQueue.size());
+    return statistics;
+}
+
+void KDBusService::setOpenRequestChunkSize(int size)
+{
+    d->openChunkSize = size;
+}
+
+int KDBusService::openRequestChunkSize() const
+{
+    return d->openChunkSize;
+}
+
+void KDBusService::setBusy(bool busy)
+{
+    d->busy = busy;
+    d->updateLoad();
+}
+
+bool KDBusService::isBusy() const
+{
+    return d->isBusy();
+}
+
+uint KDBusService::pendingActivations() const
+{
+    return uint(d->activationQueue.size());
+}
+
+QDBusConnection KDBusService::connection() const
+{
+    return d->connection;
+}
+
 QString KDBusService::serviceName() const
 {
     return d->serviceName;
@@ -295,47 +1414,128 @@ QString KDBusService::serviceName() const
 void KDBusService::unregister()
 {
     QDBusConnectionInterface *bus = nullptr;
-    if (!d->registered || !QDBusConnection::sessionBus().isConnected() || !(bus = QDBusConnection::sessionBus().interface())) {
+    if (!d->registered || !d->connection.isConnected() || !(bus = d->connection.interface())) {
         return;
     }
     bus->unregisterService(d->serviceName);
+    if (!d->shardEntryName.isEmpty()) {
+        bus->unregisterService(d->shardEntryName);
+    }
 }
 
 void KDBusService::Activate(const QVariantMap &platform_data)
 {
-    d->handlePlatformData(platform_data);
-    Q_EMIT activateRequested(QStringList(QCoreApplication::arguments()[0]), QDir::currentPath());
-    qunsetenv("XDG_ACTIVATION_TOKEN");
+    PendingActivation activation;
+    activation.type = PendingActivation::Activate;
+    activation.platformData = platform_data;
+    d->handleActivation(std::move(activation));
 }
 
 void KDBusService::Open(const QStringList &uris, const QVariantMap &platform_data)
 {
-    d->handlePlatformData(platform_data);
-    Q_EMIT openRequested(QUrl::fromStringList(uris));
-    qunsetenv("XDG_ACTIVATION_TOKEN");
+    PendingActivation activation;
+    activation.type = PendingActivation::Open;
+    activation.uris = uris;
+    activation.platformData = platform_data;
+    d->handleActivation(std::move(activation));
 }
 
 void KDBusService::ActivateAction(const QString &action_name, const QVariantList &maybeParameter, const QVariantMap &platform_data)
 {
-    d->handlePlatformData(platform_data);
-
+    PendingActivation activation;
+    activation.type = PendingActivation::ActivateAction;
+    activation.actionName = action_name;
     // This is a workaround for D-Bus not supporting null variants.
-    const QVariant param = maybeParameter.count() == 1 ? maybeParameter.first() : QVariant();
+    activation.parameter = maybeParameter.count() == 1 ? maybeParameter.first() : QVariant();
+    activation.platformData = platform_data;
+    d->handleActivation(std::move(activation));
+}
 
-    Q_EMIT activateActionRequested(action_name, param);
-    qunsetenv("XDG_ACTIVATION_TOKEN");
+int KDBusService::CommandLineFd(const QDBusUnixFileDescriptor &arguments, const QString &workingDirectory, const QVariantMap &platform_data)
+{
+    const qint64 receivedAt = KDBusAddonsTrace::timestamp();
+    QStringList argumentList;
+    if (!readArgumentsDescriptor(arguments, &argumentList)) {
+        qCWarning(KDBUSADDONS_LOG) << "Could not read the arguments passed to" << d->serviceName;
+        return 1;
+    }
+    return d->commandLine(argumentList, workingDirectory, platform_data, QStringLiteral("CommandLineFd"), receivedAt);
 }
 
 int KDBusService::CommandLine(const QStringList &arguments, const QString &workingDirectory, const QVariantMap &platform_data)
 {
-    d->exitValue = 0;
-    d->handlePlatformData(platform_data);
-    // The TODOs here only make sense if this method can be called from the GUI.
-    // If it's for pure "usage in the terminal" then no startup notification got started.
-    // But maybe one day the workspace wants to call this for the Exec key of a .desktop file?
-    Q_EMIT activateRequested(arguments, workingDirectory);
-    qunsetenv("XDG_ACTIVATION_TOKEN");
-    return d->exitValue;
+    return d->commandLine(arguments, workingDirectory, platform_data, QStringLiteral("CommandLine"), KDBusAddonsTrace::timestamp());
+}
+
+QDBusUnixFileDescriptor KDBusService::Handover()
+{
+    // Anyone on the bus could make us drop the name otherwise, only the instance replacing us is queued for it
+    QDBusMessage queueMessage = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.DBus"),
+                                                               QStringLiteral("/org/freedesktop/DBus"),
+                                                               QStringLiteral("org.freedesktop.DBus"),
+                                                               QStringLiteral("ListQueuedOwners"));
+    queueMessage << d->serviceName;
+    const QDBusReply<QStringList> queuedOwners = d->connection.call(queueMessage, QDBus::Block, s_probeTimeout);
+    const QString caller = message().service();
+    if (!queuedOwners.isValid() || !queuedOwners.value().contains(caller) || queuedOwners.value().constFirst() == caller) {
+        sendErrorReply(QDBusError::AccessDenied, QStringLiteral("Only an instance waiting for %1 can take it over").arg(d->serviceName));
+        return QDBusUnixFileDescriptor();
+    }
+
+    if (!isSignalConnected(QMetaMethod::fromSignal(&KDBusService::handoverRequested))) {
+        sendErrorReply(QDBusError::NotSupported, QStringLiteral("The application does not hand over its state"));
+        return QDBusUnixFileDescriptor();
+    }
+
+    QByteArray state;
+    Q_EMIT handoverRequested(&state);
+    const QDBusUnixFileDescriptor descriptor = sealedMemoryFile("kdbusservice-state", state);
+    if (!descriptor.isValid()) {
+        sendErrorReply(QDBusError::Failed, QStringLiteral("Could not pass on the state"));
+        return QDBusUnixFileDescriptor();
+    }
+
+    // Releasing the name right away lets the new instance take over while we shut down
+    QMetaObject::invokeMethod(this, &KDBusService::unregister, Qt::QueuedConnection);
+    return descriptor;
+}
+
+QList<KDBusService::ActivationLatency> KDBusService::activationLatencies() const
+{
+    if (d->latencies.size() < s_latencyHistorySize) {
+        return d->latencies;
+    }
+    return d->latencies.mid(d->nextLatency) + d->latencies.mid(0, d->nextLatency);
+}
+
+// Adds the number, median, 95th percentile and maximum of the given times
+static void addPercentiles(QVariantMap *statistics, const QString &prefix, QList<qint64> times)
+{
+    statistics->insert(prefix + QStringLiteral("count"), qint64(times.size()));
+    if (times.isEmpty()) {
+        return;
+    }
+    std::sort(times.begin(), times.end());
+    statistics->insert(prefix + QStringLiteral("p50"), times.at((times.size() - 1) / 2));
+    statistics->insert(prefix + QStringLiteral("p95"), times.at((times.size() - 1) * 95 / 100));
+    statistics->insert(prefix + QStringLiteral("max"), times.constLast());
+}
+
+QVariantMap KDBusService::ActivationLatencyStatistics() const
+{
+    QList<qint64> handlingTimes;
+    QList<qint64> endToEndTimes;
+    for (const ActivationLatency &latency : std::as_const(d->latencies)) {
+        handlingTimes << latency.handlingTime;
+        if (latency.endToEndTime >= 0) {
+            endToEndTimes << latency.endToEndTime;
+        }
+    }
+
+    QVariantMap statistics;
+    addPercentiles(&statistics, QStringLiteral("handling-"), handlingTimes);
+    addPercentiles(&statistics, QStringLiteral("end-to-end-"), endToEndTimes);
+    return statistics;
 }
 
 #include "kdbusservice.moc"
@@ -10,13 +10,19 @@
 #ifndef KDBUSSERVICE_H
 #define KDBUSSERVICE_H
 
+#include <QDBusConnection>
+#include <QDBusContext>
 #include <QObject>
 #include <QUrl>
 #include <memory>
+#include <optional>
 
 #include <kdbusaddons_export.h>
 
+#include "kdbusactivationcontext.h"
+
 class KDBusServicePrivate;
+class QDBusUnixFileDescriptor;
 
 /*!
  * \class KDBusService
@@ -42,6 +48,18 @@ class KDBusServicePrivate;
  * duplicate instance will then quit. The exit value can be set by the already
  * running instance with setExitValue(), the default value is \c 0.
  *
+ * The arguments of a duplicate instance are handed over in the D-Bus message.
+ * Where file descriptor passing and \c memfd_create() are available, argument
+ * lists larger than 64 KiB are written to a sealed memory file instead, which
+ * the running instance maps and parses directly. The environment variable
+ * \c KDBUSADDONS_FD_PASSING_THRESHOLD changes the size limit, \c 0 disables this.
+ *
+ * When the environment variable \c KDBUSADDONS_TRACE_FILE is set, the
+ * registration phases, the calls forwarding to a running instance, waits for
+ * the service name and the emission of the activation signals are written to that file
+ * in the Chrome trace event format, which Perfetto can open and merge with other
+ * traces. \c %p in the file name is replaced by the process ID.
+ *
  * Unique-mode applications should usually delay parsing command-line arguments
  * until after creating a KDBusService object; that way they know they are the
  * original instance of the application.
@@ -49,6 +67,11 @@ class KDBusServicePrivate;
  * Applications that set the D-Bus activation entry (\c DBusActivatable=true) in
  * their desktop files will use Unique mode and connect to the signals emitted
  * by this class.
+ * When the bus daemon starts such an application to deliver a call, KDBusService
+ * takes the name right away without probing for a running instance first, and
+ * handles that call without waiting for the activation queue. The first call to
+ * Activate, Open, ActivateAction or CommandLine within 25 seconds is taken to
+ * be that call.
  * Note that the D-Bus interface is exported for Multiple-mode applications as
  * well, so it also makes sense for such applications to connect to the signals
  * emitted by this class.
@@ -76,10 +99,14 @@ class KDBusServicePrivate;
  *
  * \since 5.0
  */
-class KDBUSADDONS_EXPORT KDBusService : public QObject
+class KDBUSADDONS_EXPORT KDBusService : public QObject, protected QDBusContext
 {
     Q_OBJECT
 
+    // Properties of org.kde.KDBusService, read by its adaptor
+    Q_PROPERTY(bool Busy READ isBusy NOTIFY busyChanged)
+    Q_PROPERTY(uint PendingActivations READ pendingActivations)
+
 public:
     /*!
      * \enum KDBusService::StartupOption
@@ -103,18 +130,150 @@ public:
      * to be quit and replaced with our own.
      * If exported, it will try first quitting the service calling
      * \c org.qtproject.Qt.QCoreApplication.quit,
-     * which is exported by KDBusService by default.
+     * which is exported by KDBusService by default, and then waits for the
+     * name to be released. If the running instance hands over its state
+     * first, it is available from handoverState().
+     * \value [since 6.28] MultipleWhenBusy
+     * Only meaningful together with \c Unique. Indicates that if the already
+     * running instance reports itself as busy or does not answer within a
+     * second, this instance should not hand over its arguments, but register
+     * like a \c Multiple instance and keep running. See setBusy() and
+     * setForwardingTimeout().
+     * \value [since 6.28] MinimalMainApplication
+     * Indicates that \c /MainApplication should only offer the \c quit method
+     * of \c org.qtproject.Qt.QCoreApplication and the D-Bus adaptors the
+     * application added to its QCoreApplication. By default all slots and
+     * scriptable properties of the application object are exported as well,
+     * which makes registering and introspecting the object more expensive.
+     * \value [since 6.28] Sharded
+     * Use instead of \c Unique. Up to shardLimit() instances run at the same
+     * time, registered as \e org.kde.app.shard-0, \e org.kde.app.shard-1 and so
+     * on. A new instance hands its arguments over to the shard chosen by
+     * shardRouting(), or becomes that shard if it is not running yet. If that
+     * shard is busy, see \c MultipleWhenBusy, or does not take the arguments,
+     * the least loaded other shard is
+     * used, and if no shard responds, the instance runs on its own like a
+     * \c Multiple instance. One of the shards also holds the well-known name
+     * \e org.kde.app, which passes on to another shard when it exits. This
+     * spreads heavy work across processes. See shardIndex().
      */
     enum StartupOption {
         Unique = 1,
         Multiple = 2,
         NoExitOnFailure = 4,
-        Replace = 8
+        Replace = 8,
+        MultipleWhenBusy = 16,
+        MinimalMainApplication = 32,
+        Sharded = 64
     };
     Q_ENUM(StartupOption)
     Q_DECLARE_FLAGS(StartupOptions, StartupOption)
     Q_FLAG(StartupOptions)
 
+    /*!
+     * \enum KDBusService::ShardRouting
+     * How a new instance chooses its shard with the \c Sharded option.
+     * \value RouteByArguments
+     * The same arguments, like the same document, always go to the same shard.
+     * Only positional arguments are used, arguments starting with a dash are
+     * ignored. Give option values in the same argument, like
+     * \c{--geometry=800x600}, since a value in the following argument cannot
+     * be told apart from a document and changes the shard.
+     * \value RouteByUrlHost
+     * URLs with the same host go to the same shard. Local files are routed by
+     * their arguments.
+     * \value RouteToLeastLoaded
+     * An idle shard is preferred, then a new shard, then the shard with the
+     * fewest pending activations. Busy shards are avoided.
+     *
+     * Without arguments, the least loaded shard is always used.
+     *
+     * \since 6.28
+     */
+    enum ShardRouting {
+        RouteByArguments,
+        RouteByUrlHost,
+        RouteToLeastLoaded
+    };
+    Q_ENUM(ShardRouting)
+
+    /*!
+     * \enum KDBusService::ActivationMergePolicy
+     * How queued activation requests are merged, see setActivationQueueLimit().
+     * \value NoMerge
+     * Every request is handled.
+     * \value MergeDuplicateOpen
+     * URLs that are already waiting in the queue to be opened are dropped from
+     * further \c Open requests. Requests that are left without URLs are dropped,
+     * and their activation token is passed on to the queued request.
+     *
+     * \since 6.28
+     */
+    enum ActivationMergePolicy {
+        NoMerge,
+        MergeDuplicateOpen
+    };
+    Q_ENUM(ActivationMergePolicy)
+
+    /*!
+     * \struct KDBusService::ActivationQueueStatistics
+     * \inmodule KDBusAddons
+     * \brief Metrics of the activation queue, see activationQueueStatistics().
+     *
+     * \variable KDBusService::ActivationQueueStatistics::depth
+     * The number of requests currently waiting in the queue.
+     *
+     * \variable KDBusService::ActivationQueueStatistics::peakDepth
+     * The highest number of requests that were waiting at the same time.
+     *
+     * \variable KDBusService::ActivationQueueStatistics::processed
+     * The number of requests that went through the queue.
+     *
+     * \variable KDBusService::ActivationQueueStatistics::merged
+     * The number of requests that were dropped by the merge policy.
+     *
+     * \variable KDBusService::ActivationQueueStatistics::totalWaitTime
+     * The time in milliseconds all processed requests spent waiting in the queue.
+     *
+     * \variable KDBusService::ActivationQueueStatistics::maxWaitTime
+     * The longest time in milliseconds a single request spent waiting in the queue.
+     *
+     * \since 6.28
+     */
+    struct ActivationQueueStatistics {
+        int depth = 0;
+        int peakDepth = 0;
+        quint64 processed = 0;
+        quint64 merged = 0;
+        qint64 totalWaitTime = 0;
+        qint64 maxWaitTime = 0;
+    };
+
+    /*!
+     * \struct KDBusService::ActivationLatency
+     * \inmodule KDBusAddons
+     * \brief The time one activation request took, see activationLatencies().
+     *
+     * \variable KDBusService::ActivationLatency::method
+     * The D-Bus method of the request, for example \c Open or \c CommandLine.
+     *
+     * \variable KDBusService::ActivationLatency::handlingTime
+     * The time in microseconds from receiving the request until the signal
+     * handler returned, including the time spent in the activation queue.
+     *
+     * \variable KDBusService::ActivationLatency::endToEndTime
+     * The time in microseconds from the duplicate instance sending the request
+     * until the signal handler returned, or \c -1 when the sender did not
+     * include its send time.
+     *
+     * \since 6.28
+     */
+    struct ActivationLatency {
+        QString method;
+        qint64 handlingTime = 0;
+        qint64 endToEndTime = -1;
+    };
+
     /*!
      * Tries to register the current process to D-Bus at an address based on the
      * application name and organization domain under the given \a parent.
@@ -132,6 +291,20 @@ public:
      */
     explicit KDBusService(StartupOptions options = Multiple, QObject *parent = nullptr);
 
+    /*!
+     * Tries to register the current process at an address based on the
+     * application name and organization domain on the bus of the given
+     * \a connection, under the given \a parent.
+     *
+     * This allows using a dedicated bus instead of the session bus. The
+     * objects are exported, duplicate instances are detected and the
+     * arguments are forwarded over \a connection.
+     *
+     * \sa KDBusService(StartupOptions, QObject *)
+     * \since 6.28
+     */
+    KDBusService(StartupOptions options, const QDBusConnection &connection, QObject *parent = nullptr);
+
     /*!
      * Destroys this object (but does not unregister the application).
      *
@@ -157,6 +330,12 @@ public:
      */
     QString serviceName() const;
 
+    /*!
+     * Returns the connection the service is registered on.
+     * \since 6.28
+     */
+    QDBusConnection connection() const;
+
     /*!
      * Returns the error message from the D-Bus registration if it failed.
      *
@@ -180,6 +359,301 @@ public:
      */
     void setExitValue(int value);
 
+    /*!
+     * Sets how long a duplicate instance of a \c Unique application waits
+     * for the running instance to handle its arguments, in milliseconds.
+     *
+     * This has to be called before creating the KDBusService object. A value
+     * of \c 0 restores the default of five minutes. The environment variable
+     * \c KDBUSADDONS_FORWARDING_TIMEOUT takes precedence over this setting.
+     *
+     * Before forwarding, the duplicate instance pings the running instance
+     * with a deadline of one second. The bus library answers the ping by
+     * itself, so a failed ping means that the process is stopped or gone. The
+     * arguments are then not forwarded, and the duplicate instance waits a bit
+     * for the name to be released instead. A running instance that answers
+     * the ping gets the arguments even if it is slow to handle them.
+     *
+     * With \c MultipleWhenBusy, the duplicate instance also reads the \c Busy
+     * property of the running instance with the same deadline, and registers
+     * as a \c Multiple instance if it is busy or its event loop does not
+     * answer in time.
+     *
+     * \since 6.28
+     */
+    static void setForwardingTimeout(int msecs);
+
+    /*!
+     * Returns how long a duplicate instance waits for the running instance
+     * to handle its arguments, in milliseconds.
+     *
+     * \since 6.28
+     */
+    static int forwardingTimeout();
+
+    /*!
+     * Starts connecting to the D-Bus session bus in a background thread.
+     *
+     * Connecting, authenticating and saying hello to the bus daemon take
+     * several round-trips. Calling this as soon as the QCoreApplication object
+     * exists overlaps them with the remaining startup of the application, like
+     * loading plugins and settings. A KDBusService created later on the session
+     * bus then uses the connection, and only waits if it is not ready yet.
+     *
+     * \code
+     * QApplication app(argc, argv);
+     * KDBusService::prepareSessionBus();
+     * // ... set up the application
+     * KDBusService service(KDBusService::Unique);
+     * \endcode
+     *
+     * \since 6.28
+     */
+    static void prepareSessionBus();
+
+    /*!
+     * Sets the maximum number of shards with the \c Sharded option to \a limit.
+     *
+     * All instances of the application have to agree on this. It must be set
+     * before creating the KDBusService object.
+     *
+     * \since 6.28
+     */
+    static void setShardLimit(int limit);
+
+    /*!
+     * Returns the maximum number of shards, by default the number of CPU cores.
+     *
+     * \since 6.28
+     */
+    static int shardLimit();
+
+    /*!
+     * Sets how a new instance chooses its shard with the \c Sharded option to \a routing.
+     *
+     * It must be set before creating the KDBusService object. The default is
+     * \c RouteByArguments.
+     *
+     * \since 6.28
+     */
+    static void setShardRouting(ShardRouting routing);
+
+    /*!
+     * Returns how a new instance chooses its shard with the \c Sharded option.
+     *
+     * \since 6.28
+     */
+    static ShardRouting shardRouting();
+
+    /*!
+     * Returns the number of the shard this instance runs as, or \c -1 without the \c Sharded option.
+     *
+     * \since 6.28
+     */
+    int shardIndex() const;
+
+    /*!
+     * Hands the command line \a argc and \a argv over to the running
+     * instance registered as \a serviceName, before any application object exists.
+     *
+     * A duplicate instance of a \c Unique application normally only learns
+     * that it is a duplicate when it creates its KDBusService, after having set
+     * up QApplication, its platform integration and plugins. Calling this at
+     * the top of \c main() skips all of that:
+     *
+     * \code
+     * int main(int argc, char **argv)
+     * {
+     *     if (const auto exitValue = KDBusService::forwardIfRunning(argc, argv, QStringLiteral("org.kde.myapp"))) {
+     *         return *exitValue;
+     *     }
+     *     QApplication app(argc, argv);
+     *     // ...
+     *     KDBusService service(KDBusService::Unique);
+     * \endcode
+     *
+     * The arguments are sent as \c CommandLine request, or as \c Activate
+     * request when there are none. A temporary session bus connection is used.
+     *
+     * Returns the exit value set by the running instance, or no value when
+     * \a serviceName is not running, does not answer within a second, reports
+     * itself busy, or did not take the request. The application should then
+     * start normally, and its KDBusService decides according to its startup
+     * options.
+     *
+     * When the bus daemon started the process to deliver a call to its name, no
+     * instance was running and this returns no value without contacting the bus.
+     *
+     * \since 6.28
+     */
+    static std::optional<int> forwardIfRunning(int argc, char **argv, const QString &serviceName);
+
+    /*!
+     * Returns the context of the activation request that is currently handled.
+     *
+     * This is only valid while activateRequested(), openRequested() or
+     * activateActionRequested() is emitted, and gives direct access to the
+     * platform data of the request, like the XDG activation token.
+     *
+     * Note that this will only work if the signal-slot connection type is
+     * Qt::DirectConnection.
+     *
+     * \since 6.28
+     */
+    KDBusActivationContext activationContext() const;
+
+    /*!
+     * Sets whether the XDG activation token of a request is exported in the
+     * \c XDG_ACTIVATION_TOKEN environment variable while the activation
+     * signals are emitted.
+     *
+     * Modifying the environment is not thread-safe. Applications which take
+     * the token from activationContext() should disable this.
+     * Defaults to \c true.
+     *
+     * \since 6.28
+     */
+    void setActivationTokenEnvironmentEnabled(bool enabled);
+
+    /*!
+     * Returns whether the XDG activation token is exported in the environment.
+     *
+     * \since 6.28
+     */
+    bool isActivationTokenEnvironmentEnabled() const;
+
+    /*!
+     * Sets the maximum number of activation requests waiting to be handled to \a limit.
+     *
+     * By default the limit is \c 0, and activateRequested(), openRequested()
+     * and activateActionRequested() are emitted right when the respective
+     * D-Bus call arrives. With a positive limit, \c Activate, \c Open and
+     * \c ActivateAction requests are queued instead and handled one after
+     * the other, spaced by activationInterval(), so a burst of requests does
+     * not block the event loop. When the queue is full, the oldest request is
+     * handled while the caller waits for the reply, which slows the callers down.
+     * Requests that are still queued when the limit is set to 0 are handled
+     * before any new request.
+     *
+     * \c CommandLine requests return the exit value of the handler to the
+     * caller and are always handled right away.
+     *
+     * \since 6.28
+     */
+    void setActivationQueueLimit(int limit);
+
+    /*!
+     * Returns the maximum number of activation requests waiting to be handled.
+     *
+     * \since 6.28
+     */
+    int activationQueueLimit() const;
+
+    /*!
+     * Sets the minimum time in milliseconds between handling two queued
+     * activation requests to \a msecs. Defaults to \c 0, which handles one
+     * request per event loop iteration.
+     *
+     * \since 6.28
+     */
+    void setActivationInterval(int msecs);
+
+    /*!
+     * Returns the minimum time in milliseconds between handling two queued activation requests.
+     *
+     * \since 6.28
+     */
+    int activationInterval() const;
+
+    /*!
+     * Sets how queued activation requests are merged to \a policy.
+     * Defaults to \c NoMerge.
+     *
+     * \since 6.28
+     */
+    void setActivationMergePolicy(ActivationMergePolicy policy);
+
+    /*!
+     * Returns how queued activation requests are merged.
+     *
+     * \since 6.28
+     */
+    ActivationMergePolicy activationMergePolicy() const;
+
+    /*!
+     * Returns the metrics of the activation queue.
+     *
+     * \since 6.28
+     */
+    ActivationQueueStatistics activationQueueStatistics() const;
+
+    /*!
+     * Returns how long the most recent activation requests took, oldest first.
+     *
+     * The last 256 requests are kept. The \c ActivationLatencyStatistics method
+     * of the \c org.kde.KDBusService D-Bus interface returns the count, median,
+     * 95th percentile and maximum of these times, for sampling by monitoring tools.
+     *
+     * \since 6.28
+     */
+    QList<ActivationLatency> activationLatencies() const;
+
+    /*!
+     * Returns the state the replaced instance handed over, or an empty array.
+     *
+     * The data is mapped from the memory file the previous instance wrote
+     * and stays valid as long as this object exists. Copy what is needed
+     * longer than that.
+     *
+     * \since 6.28
+     * \sa handoverRequested()
+     */
+    QByteArray handoverState() const;
+
+    /*!
+     * Sets the maximum number of URLs handed out by a single openRequested() signal to \a size.
+     *
+     * By default the size is \c 0, and all URLs of an \c Open request are
+     * parsed and handed out at once. With a positive size, large requests are
+     * split into chunks. Only the URLs of the next chunk are parsed, and the
+     * chunks are emitted in consecutive event loop iterations, so huge
+     * selections do not block the event loop. The XDG activation token and the
+     * startup id only come with the first chunk.
+     *
+     * \since 6.28
+     */
+    void setOpenRequestChunkSize(int size);
+
+    /*!
+     * Returns the maximum number of URLs handed out by a single openRequested() signal.
+     *
+     * \since 6.28
+     */
+    int openRequestChunkSize() const;
+
+    /*!
+     * Sets whether the application is \a busy.
+     *
+     * The state is published as the \c Busy property of the
+     * \c org.kde.KDBusService interface, together with the number of queued
+     * activation requests as \c PendingActivations. Changes are announced
+     * with \c org.freedesktop.DBus.Properties.PropertiesChanged.
+     *
+     * Instances started later with the \c MultipleWhenBusy option do not
+     * forward to a busy instance.
+     *
+     * \since 6.28
+     */
+    void setBusy(bool busy);
+
+    /*!
+     * Returns whether the application is busy, either because it was set
+     * with setBusy() or because the activation queue is full.
+     *
+     * \since 6.28
+     */
+    bool isBusy() const;
+
 Q_SIGNALS:
     /*!
      * Signals that the application is to be activated.
@@ -218,6 +692,7 @@ Q_SIGNALS:
      * from QX11Info::nextStartupId(), if there is one.
      * For Wayland, KDBusService provides the token for the XDG Activation protocol in the
      * "XDG_ACTIVATION_TOKEN" environment variable and unsets it again after the signal, if there is one.
+     * The token is also available from activationContext(), see setActivationTokenEnvironmentEnabled().
      * The util method \c KWindowSystem::updateStartupId(QWindow *window) (since KF 5.91) takes care of that.
      * A typical implementation in the signal handler would be:
      * \code
@@ -244,6 +719,8 @@ Q_SIGNALS:
      * See documentation of activateRequested(const QStringList &arguments, const QString &)
      * for details.
      *
+     * One request may be split into several signals, see setOpenRequestChunkSize().
+     *
      * \a uris  The URLs of the files to open.
      */
     void openRequested(const QList<QUrl> &uris);
@@ -262,6 +739,30 @@ Q_SIGNALS:
      */
     void activateActionRequested(const QString &actionName, const QVariant &parameter);
 
+    /*!
+     * Emitted when the application becomes \a busy or stops being busy.
+     *
+     * \since 6.28
+     * \sa isBusy()
+     */
+    void busyChanged(bool busy);
+
+    /*!
+     * Emitted when a new instance started with the \c Replace option takes over.
+     *
+     * Write everything the new instance needs to serve requests right away,
+     * like caches or the list of open documents, into \a state. It is passed
+     * on in a sealed memory file, which the new instance maps rather than
+     * copies. Right after handing over, the service name is released, and the
+     * application is asked to quit.
+     *
+     * The connection must be direct. Without a connection, no state is handed over.
+     *
+     * \since 6.28
+     * \sa handoverState()
+     */
+    void handoverRequested(QByteArray *state);
+
 public Q_SLOTS:
     /*!
      * Manually unregister the given serviceName from D-Bus.
@@ -277,6 +778,10 @@ private:
 
     // org.kde.KDBusService
     KDBUSADDONS_NO_EXPORT int CommandLine(const QStringList &arguments, const QString &workingDirectory, const QVariantMap &platform_data);
+    KDBUSADDONS_NO_EXPORT int CommandLineFd(const QDBusUnixFileDescriptor &arguments, const QString &workingDirectory, const QVariantMap &platform_data);
+    KDBUSADDONS_NO_EXPORT uint pendingActivations() const;
+    KDBUSADDONS_NO_EXPORT QVariantMap ActivationLatencyStatistics() const;
+    KDBUSADDONS_NO_EXPORT QDBusUnixFileDescriptor Handover();
     friend class KDBusServiceExtensionsAdaptor;
 
 private:
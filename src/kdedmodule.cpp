@@ -13,10 +13,20 @@
 #include <QDBusMessage>
 #include <QDBusObjectPath>
 
+#include <optional>
+
 class KDEDModulePrivate
 {
 public:
     QString moduleName;
+    // Set by setConnection(). Modules created before the application has a session bus
+    // connection must not open one in their constructor, so the default is looked up in bus()
+    std::optional<QDBusConnection> connection;
+
+    QDBusConnection bus() const
+    {
+        return connection ? *connection : QDBusConnection::sessionBus();
+    }
 };
 
 KDEDModule::KDEDModule(QObject *parent)
@@ -58,7 +68,7 @@ void KDEDModule::setModuleName(const QString &name)
         qCDebug(KDBUSADDONS_LOG) << "Registration of kded module" << d->moduleName << "without D-Bus interface.";
     }
 
-    if (!QDBusConnection::sessionBus().registerObject(realPath.path(), this, regOptions)) {
+    if (!d->bus().registerObject(realPath.path(), this, regOptions)) {
         // Happens for khotkeys but the module works. Need some time to investigate.
         qCDebug(KDBUSADDONS_LOG) << "registerObject() returned false for" << d->moduleName;
     } else {
@@ -71,6 +81,16 @@ void KDEDModule::setModuleName(const QString &name)
     }
 }
 
+void KDEDModule::setConnection(const QDBusConnection &connection)
+{
+    d->connection = connection;
+}
+
+QDBusConnection KDEDModule::connection() const
+{
+    return d->bus();
+}
+
 QString KDEDModule::moduleName() const
 {
     return d->moduleName;
@@ -17,6 +17,7 @@
 class KDEDModulePrivate;
 class Kded;
 
+class QDBusConnection;
 class QDBusObjectPath;
 class QDBusMessage;
 
@@ -54,6 +55,20 @@ public:
      */
     void setModuleName(const QString &name);
 
+    /*!
+     * Sets the \a connection the module is registered on by setModuleName().
+     *
+     * The default is the session bus. This has to be called before setModuleName().
+     * \since 6.28
+     */
+    void setConnection(const QDBusConnection &connection);
+
+    /*!
+     * The connection the module is registered on.
+     * \since 6.28
+     */
+    QDBusConnection connection() const;
+
     /*!
      * The name of the module used to register to D-Bus.
      */
@@ -0,0 +1,92 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "klaunchenvironmentstate.h"
+#include "kupdatelaunchenvironmentjob_p.h"
+
+#include <QMutex>
+
+namespace
+{
+struct State {
+    QMutex mutex;
+    QMap<KLaunchEnvironmentState::Backend, QMap<QString, QString>> acknowledged;
+};
+
+State &state()
+{
+    static State state;
+    return state;
+}
+
+const KLaunchEnvironmentState::Backend s_backends[] = {
+    KLaunchEnvironmentState::PlasmaSession,
+    KLaunchEnvironmentState::DBusActivation,
+    KLaunchEnvironmentState::Systemd,
+};
+}
+
+QProcessEnvironment KLaunchEnvironmentState::environment(Backend backend)
+{
+    QProcessEnvironment environment;
+    const QMutexLocker locker(&state().mutex);
+    const QMap<QString, QString> variables = state().acknowledged.value(backend);
+    for (auto it = variables.cbegin(); it != variables.cend(); ++it) {
+        environment.insert(it.key(), it.value());
+    }
+    return environment;
+}
+
+bool KLaunchEnvironmentState::contains(const QProcessEnvironment &environment, Backends backends)
+{
+    return missing(environment, backends).isEmpty();
+}
+
+QProcessEnvironment KLaunchEnvironmentState::missing(const QProcessEnvironment &environment, Backends backends)
+{
+    QProcessEnvironment missing;
+    const QMutexLocker locker(&state().mutex);
+    const QStringList names = environment.keys();
+    for (const QString &name : names) {
+        // Never synced, so never acknowledged either
+        if (!KUpdateLaunchEnvironmentJobPrivate::isPosixName(name)) {
+            continue;
+        }
+        const QString value = environment.value(name);
+        for (Backend backend : s_backends) {
+            if (!(backends & backend)) {
+                continue;
+            }
+            if (backend == Systemd && !KUpdateLaunchEnvironmentJobPrivate::isSystemdApprovedValue(value)) {
+                continue;
+            }
+            const QMap<QString, QString> &variables = state().acknowledged[backend];
+            const auto it = variables.constFind(name);
+            if (it == variables.cend() || it.value() != value) {
+                missing.insert(name, value);
+                break;
+            }
+        }
+    }
+    return missing;
+}
+
+void KLaunchEnvironmentState::clear()
+{
+    const QMutexLocker locker(&state().mutex);
+    state().acknowledged.clear();
+}
+
+void KLaunchEnvironmentState::acknowledge(Backend backend, const QMap<QString, QString> &variables)
+{
+    const QMutexLocker locker(&state().mutex);
+    QMap<QString, QString> &acknowledged = state().acknowledged[backend];
+    for (auto it = variables.cbegin(); it != variables.cend(); ++it) {
+        acknowledged.insert(it.key(), it.value());
+    }
+}
@@ -0,0 +1,103 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KLAUNCHENVIRONMENTSTATE_H
+#define KLAUNCHENVIRONMENTSTATE_H
+
+#include <kdbusaddons_export.h>
+
+#include <QMap>
+#include <QProcessEnvironment>
+
+/*!
+ * \class KLaunchEnvironmentState
+ * \inmodule KDBusAddons
+ * \brief The launch environment this process has published.
+ *
+ * Whenever a backend acknowledges a KUpdateLaunchEnvironmentJob, the
+ * variables it accepted are recorded here. This allows answering what was
+ * last published without a D-Bus round-trip, and skipping updates that
+ * would not change anything:
+ *
+ * \code
+ * const QProcessEnvironment missing = KLaunchEnvironmentState::missing(newEnv);
+ * if (!missing.isEmpty()) {
+ *     new KUpdateLaunchEnvironmentJob(missing);
+ * }
+ * \endcode
+ *
+ * Only the updates made by this process are known. Other processes may have
+ * changed the launch environment since.
+ *
+ * All methods are thread-safe.
+ *
+ * \since 6.28
+ */
+class KDBUSADDONS_EXPORT KLaunchEnvironmentState
+{
+public:
+    /*!
+     * The backends a KUpdateLaunchEnvironmentJob updates.
+     *
+     * \value PlasmaSession
+     *        The \c org.kde.Startup service of the Plasma session.
+     * \value DBusActivation
+     *        The activation environment of the D-Bus daemon.
+     * \value Systemd
+     *        The environment of the systemd user manager. Variables whose
+     *        values systemd does not accept are never recorded for it.
+     * \value AllBackends
+     *        All of the above.
+     */
+    enum Backend {
+        PlasmaSession = 0x1,
+        DBusActivation = 0x2,
+        Systemd = 0x4,
+        AllBackends = PlasmaSession | DBusActivation | Systemd
+    };
+    Q_DECLARE_FLAGS(Backends, Backend)
+
+    /*!
+     * Returns the variables \a backend has acknowledged.
+     */
+    static QProcessEnvironment environment(Backend backend);
+
+    /*!
+     * Returns whether all \a backends have acknowledged every variable of \a environment with its value.
+     *
+     * Variables that are never passed on to a backend are ignored, see missing().
+     */
+    static bool contains(const QProcessEnvironment &environment, Backends backends = AllBackends);
+
+    /*!
+     * Returns the variables of \a environment that at least one of \a backends
+     * has not acknowledged with the given value yet.
+     *
+     * Variables that KUpdateLaunchEnvironmentJob never passes on to a backend
+     * are not reported for it: names with characters other than letters,
+     * digits and underscores, and for \c Systemd values with control
+     * characters. So the variables returned here can always be settled by
+     * updating them.
+     */
+    static QProcessEnvironment missing(const QProcessEnvironment &environment, Backends backends = AllBackends);
+
+    /*!
+     * Forgets everything that was recorded, for example when the session was restarted.
+     */
+    static void clear();
+
+private:
+    KLaunchEnvironmentState() = delete;
+
+    static void acknowledge(Backend backend, const QMap<QString, QString> &variables);
+    friend class KUpdateLaunchEnvironmentJobPrivate;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KLaunchEnvironmentState::Backends)
+
+#endif
@@ -0,0 +1,181 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kquitservicejob.h"
+#include "kquitservicejob_p.h"
+
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusServiceWatcher>
+#include <QTimer>
+
+#include "kdbusaddons_debug.h"
+#include "kdbusnameowner_p.h"
+
+KQuitServiceJobPrivate::KQuitServiceJobPrivate(KQuitServiceJob *q)
+    : q(q)
+{
+}
+
+void KQuitServiceJobPrivate::finish(const QDBusError &error)
+{
+    if (finished) {
+        return;
+    }
+    finished = true;
+    this->error = error;
+
+    Q_EMIT q->finished();
+    q->deleteLater();
+}
+
+QDBusMessage KQuitServiceJobPrivate::quitMessage(const QString &service, const QString &objectPath, const QString &interfaceName)
+{
+    // A plain method call, no introspection of the service beforehand
+    return QDBusMessage::createMethodCall(service, objectPath, interfaceName, QStringLiteral("quit"));
+}
+
+bool KQuitServiceJobPrivate::mayStillRelease(const QDBusError &error)
+{
+    // The service may well have gone away before answering
+    return error.type() == QDBusError::NoReply || error.type() == QDBusError::Disconnected;
+}
+
+QDBusError KQuitServiceJobPrivate::quitAndWaitForRelease(const QDBusConnection &connection,
+                                                         const QString &serviceName,
+                                                         const QString &owner,
+                                                         const QString &objectPath,
+                                                         const QString &interfaceName,
+                                                         const QDeadlineTimer &deadline)
+{
+    const QDBusMessage reply = connection.call(quitMessage(owner, objectPath, interfaceName), QDBus::Block, int(deadline.remainingTime()));
+    if (reply.type() == QDBusMessage::ErrorMessage) {
+        const QDBusError error(reply);
+        if (!mayStillRelease(error)) {
+            return error;
+        }
+    }
+
+    const auto isReleased = [owner](const QString &newOwner) {
+        return newOwner != owner;
+    };
+    if (!KDBusNameOwner::waitFor(connection, serviceName, isReleased, deadline)) {
+        return QDBusError(QDBusError::Timeout, QStringLiteral("Service %1 did not release its name in time").arg(serviceName));
+    }
+    return QDBusError();
+}
+
+KQuitServiceJob::KQuitServiceJob(const QString &serviceName, QObject *parent)
+    : QObject(parent)
+    , d(new KQuitServiceJobPrivate(this))
+{
+    d->serviceName = serviceName;
+    QTimer::singleShot(0, this, &KQuitServiceJob::start);
+}
+
+KQuitServiceJob::~KQuitServiceJob() = default;
+
+QString KQuitServiceJob::serviceName() const
+{
+    return d->serviceName;
+}
+
+void KQuitServiceJob::setConnection(const QDBusConnection &connection)
+{
+    d->connection = connection;
+}
+
+QDBusConnection KQuitServiceJob::connection() const
+{
+    return d->connection ? *d->connection : QDBusConnection::sessionBus();
+}
+
+void KQuitServiceJob::setObjectPath(const QString &path)
+{
+    d->objectPath = path;
+}
+
+QString KQuitServiceJob::objectPath() const
+{
+    return d->objectPath;
+}
+
+void KQuitServiceJob::setInterfaceName(const QString &interface)
+{
+    d->interfaceName = interface;
+}
+
+QString KQuitServiceJob::interfaceName() const
+{
+    return d->interfaceName;
+}
+
+void KQuitServiceJob::setWaitForRelease(bool wait)
+{
+    d->waitForRelease = wait;
+}
+
+bool KQuitServiceJob::waitForRelease() const
+{
+    return d->waitForRelease;
+}
+
+void KQuitServiceJob::setTimeout(int msecs)
+{
+    d->timeout = msecs;
+}
+
+int KQuitServiceJob::timeout() const
+{
+    return d->timeout;
+}
+
+QDBusError KQuitServiceJob::error() const
+{
+    return d->error;
+}
+
+void KQuitServiceJob::start()
+{
+    QDBusConnection bus = connection();
+
+    if (d->waitForRelease) {
+        // Watch before sending the call, so that the release cannot slip through. With another
+        // instance queued for the name, it passes on to that one rather than becoming unowned.
+        auto *serviceWatcher = new QDBusServiceWatcher(d->serviceName, bus, QDBusServiceWatcher::WatchForOwnerChange, this);
+        connect(serviceWatcher, &QDBusServiceWatcher::serviceOwnerChanged, this, [this]() {
+            d->finish(QDBusError());
+        });
+        QTimer::singleShot(d->timeout, this, [this]() {
+            d->finish(QDBusError(QDBusError::Timeout, QStringLiteral("Service %1 did not release its name in time").arg(d->serviceName)));
+        });
+    }
+
+    const QDBusMessage message = KQuitServiceJobPrivate::quitMessage(d->serviceName, d->objectPath, d->interfaceName);
+    auto *callWatcher = new QDBusPendingCallWatcher(bus.asyncCall(message, d->timeout), this);
+    connect(callWatcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *callWatcher) {
+        callWatcher->deleteLater();
+        const QDBusPendingReply<> reply = *callWatcher;
+
+        if (!reply.isError()) {
+            if (!d->waitForRelease) {
+                d->finish(QDBusError());
+            }
+            return;
+        }
+
+        const QDBusError error = reply.error();
+        if (d->waitForRelease && KQuitServiceJobPrivate::mayStillRelease(error)) {
+            return; // the name watcher decides
+        }
+        qCDebug(KDBUSADDONS_LOG) << "Quitting" << d->serviceName << "failed:" << error.message();
+        d->finish(error);
+    });
+}
+
+#include "moc_kquitservicejob.cpp"
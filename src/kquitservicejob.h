@@ -0,0 +1,154 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KQUITSERVICEJOB_H
+#define KQUITSERVICEJOB_H
+
+#include <kdbusaddons_export.h>
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QObject>
+
+#include <memory>
+
+class KQuitServiceJobPrivate;
+
+/*!
+ * \class KQuitServiceJob
+ * \inmodule KDBusAddons
+ * \brief Job for asking a D-Bus service to quit.
+ *
+ * The job sends a single \c quit method call to the service, without
+ * introspecting it first. Optionally it then waits until the service has
+ * released its name on the bus, which is what callers that want to take
+ * over the name are interested in.
+ *
+ * The job starts on the next event loop iteration, so it can be configured
+ * right after construction.
+ *
+ * This object deletes itself after completion, similar to KJobs.
+ *
+ * Example usage:
+ *
+ * \code
+ * auto job = new KQuitServiceJob(u"org.kde.kuiserver"_s);
+ * job->setWaitForRelease(true);
+ * QObject::connect(job, &KQuitServiceJob::finished, &SomeClass, [job]() {
+ *     if (job->error().isValid()) {
+ *         qWarning() << job->error().message();
+ *     }
+ * });
+ * \endcode
+ *
+ * \sa KDBusService::Replace
+ *
+ * \since 6.28
+ */
+class KDBUSADDONS_EXPORT KQuitServiceJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * Creates a new job for quitting the service \a serviceName, with the given \a parent.
+     */
+    explicit KQuitServiceJob(const QString &serviceName, QObject *parent = nullptr);
+    ~KQuitServiceJob() override;
+
+    /*!
+     * Returns the name of the service to quit.
+     */
+    QString serviceName() const;
+
+    /*!
+     * Sets the \a connection of the bus the service is on.
+     *
+     * The default is the session bus.
+     */
+    void setConnection(const QDBusConnection &connection);
+
+    /*!
+     * Returns the connection of the bus the service is on.
+     */
+    QDBusConnection connection() const;
+
+    /*!
+     * Sets the object \a path the \c quit method is called on.
+     *
+     * The default is \c /MainApplication, where KDBusService exports the application object.
+     */
+    void setObjectPath(const QString &path);
+
+    /*!
+     * Returns the object path the \c quit method is called on.
+     */
+    QString objectPath() const;
+
+    /*!
+     * Sets the D-Bus \a interface the \c quit method is called on.
+     *
+     * The default is an empty interface, which lets the service pick any
+     * \c quit method exported on the object.
+     */
+    void setInterfaceName(const QString &interface);
+
+    /*!
+     * Returns the D-Bus interface the \c quit method is called on.
+     */
+    QString interfaceName() const;
+
+    /*!
+     * Sets whether the job should only finish once the service has released
+     * its name, rather than once it replied to the \c quit call. If another
+     * process is queued for the name, the job finishes once the name passed
+     * on to it.
+     *
+     * Defaults to \c false.
+     */
+    void setWaitForRelease(bool wait);
+
+    /*!
+     * Returns whether the job waits for the service name to be released.
+     */
+    bool waitForRelease() const;
+
+    /*!
+     * Sets the maximum time in milliseconds to wait for the reply and, if
+     * waitForRelease() is set, for the name to be released.
+     *
+     * Defaults to 25 seconds.
+     */
+    void setTimeout(int msecs);
+
+    /*!
+     * Returns the maximum time in milliseconds the job waits.
+     */
+    int timeout() const;
+
+    /*!
+     * Returns the error, if quitting the service failed.
+     *
+     * Only meaningful once finished() was emitted.
+     */
+    QDBusError error() const;
+
+Q_SIGNALS:
+    /*!
+     * Emitted when the job is finished, before the object is automatically deleted.
+     */
+    void finished();
+
+private:
+    KDBUSADDONS_NO_EXPORT void start();
+
+private:
+    std::unique_ptr<KQuitServiceJobPrivate> const d;
+};
+
+#endif
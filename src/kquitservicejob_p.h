@@ -0,0 +1,53 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KQUITSERVICEJOB_P_H
+#define KQUITSERVICEJOB_P_H
+
+#include <QDBusConnection>
+#include <QDBusError>
+#include <QDBusMessage>
+#include <QDeadlineTimer>
+
+#include <optional>
+
+class KQuitServiceJob;
+
+class KQuitServiceJobPrivate
+{
+public:
+    explicit KQuitServiceJobPrivate(KQuitServiceJob *q);
+    void finish(const QDBusError &error);
+
+    static QDBusMessage quitMessage(const QString &service, const QString &objectPath, const QString &interfaceName);
+    // Whether the name may still be released after quit failed with error
+    static bool mayStillRelease(const QDBusError &error);
+
+    // Asks owner, the unique name currently owning serviceName, to quit and blocks until it let go
+    // of serviceName, without dispatching events. KDBusService::Replace uses this while the
+    // application is still being set up.
+    static QDBusError quitAndWaitForRelease(const QDBusConnection &connection,
+                                            const QString &serviceName,
+                                            const QString &owner,
+                                            const QString &objectPath,
+                                            const QString &interfaceName,
+                                            const QDeadlineTimer &deadline);
+
+    KQuitServiceJob *q;
+    // Only set by setConnection(), connection() falls back to the session bus when the job starts
+    std::optional<QDBusConnection> connection;
+    QString serviceName;
+    QString objectPath = QStringLiteral("/MainApplication");
+    QString interfaceName;
+    QDBusError error;
+    int timeout = 25000;
+    bool waitForRelease = false;
+    bool finished = false;
+};
+
+#endif
@@ -6,6 +6,7 @@
 */
 
 #include "kupdatelaunchenvironmentjob.h"
+#include "kupdatelaunchenvironmentjob_p.h"
 
 #include <QDBusArgument>
 #include <QDBusConnection>
@@ -15,36 +16,44 @@
 #include <QTimer>
 
 #include "kdbusaddons_debug.h"
-
-class KUpdateLaunchEnvironmentJobPrivate
-{
-public:
-    explicit KUpdateLaunchEnvironmentJobPrivate(KUpdateLaunchEnvironmentJob *q);
-    void monitorReply(const QDBusPendingReply<> &reply);
-
-    static bool isPosixName(const QString &name);
-    static bool isSystemdApprovedValue(const QString &value);
-
-    KUpdateLaunchEnvironmentJob *q;
-    QProcessEnvironment environment;
-    int pendingReplies = 0;
-};
+#include "kdbusaddonstrace_p.h"
 
 KUpdateLaunchEnvironmentJobPrivate::KUpdateLaunchEnvironmentJobPrivate(KUpdateLaunchEnvironmentJob *q)
     : q(q)
 {
 }
 
-void KUpdateLaunchEnvironmentJobPrivate::monitorReply(const QDBusPendingReply<> &reply)
+void KUpdateLaunchEnvironmentJobPrivate::monitorReply(const QDBusPendingReply<> &reply,
+                                                      const QString &traceName,
+                                                      KLaunchEnvironmentState::Backend backend,
+                                                      const QMap<QString, QString> &variables)
 {
     ++pendingReplies;
 
+    const qint64 begin = KDBusAddonsTrace::isEnabled() ? KDBusAddonsTrace::timestamp() : 0;
     auto *watcher = new QDBusPendingCallWatcher(reply, q);
-    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, q, [this](QDBusPendingCallWatcher *watcher) {
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, q, [this, traceName, begin, backend, variables](QDBusPendingCallWatcher *watcher) {
         watcher->deleteLater();
         --pendingReplies;
 
+        if (!watcher->isError()) {
+            KLaunchEnvironmentState::acknowledge(backend, variables);
+        } else {
+            failedBackends |= backend;
+        }
+
+        if (begin) {
+            QJsonObject args;
+            if (watcher->isError()) {
+                args.insert(QStringLiteral("error"), watcher->error().name());
+            }
+            KDBusAddonsTrace::completeEvent("launch-environment", traceName, begin, args);
+        }
+
         if (pendingReplies == 0) {
+            if (traceBegin) {
+                KDBusAddonsTrace::completeEvent("launch-environment", QStringLiteral("KUpdateLaunchEnvironmentJob"), traceBegin);
+            }
             Q_EMIT q->finished();
             q->deleteLater();
         }
@@ -62,9 +71,13 @@ KUpdateLaunchEnvironmentJob::~KUpdateLaunchEnvironmentJob() = default;
 
 void KUpdateLaunchEnvironmentJob::start()
 {
+    if (KDBusAddonsTrace::isEnabled()) {
+        d->traceBegin = KDBusAddonsTrace::timestamp();
+    }
     qDBusRegisterMetaType<QMap<QString, QString>>();
     QMap<QString, QString> dbusActivationEnv;
     QStringList systemdUpdates;
+    QMap<QString, QString> systemdEnv;
 
     for (const auto &varName : d->environment.keys()) {
         if (!KUpdateLaunchEnvironmentJobPrivate::isPosixName(varName)) {
@@ -80,7 +93,7 @@ void KUpdateLaunchEnvironmentJob::start()
                                                                        QStringLiteral("updateLaunchEnv"));
         plasmaSessionMsg.setArguments({QVariant::fromValue(varName), QVariant::fromValue(value)});
         auto plasmaSessionReply = QDBusConnection::sessionBus().asyncCall(plasmaSessionMsg);
-        d->monitorReply(plasmaSessionReply);
+        d->monitorReply(plasmaSessionReply, QStringLiteral("org.kde.Startup.updateLaunchEnv"), KLaunchEnvironmentState::PlasmaSession, {{varName, value}});
 
         // DBus-activation environment
         dbusActivationEnv.insert(varName, value);
@@ -95,6 +108,7 @@ void KUpdateLaunchEnvironmentJob::start()
         }
         const QString updateString = varName + QStringLiteral("=") + value;
         systemdUpdates.append(updateString);
+        systemdEnv.insert(varName, value);
     }
 
     // DBus-activation environment
@@ -105,7 +119,10 @@ void KUpdateLaunchEnvironmentJob::start()
     dbusActivationMsg.setArguments({QVariant::fromValue(dbusActivationEnv)});
 
     auto dbusActivationReply = QDBusConnection::sessionBus().asyncCall(dbusActivationMsg);
-    d->monitorReply(dbusActivationReply);
+    d->monitorReply(dbusActivationReply,
+                    QStringLiteral("org.freedesktop.DBus.UpdateActivationEnvironment"),
+                    KLaunchEnvironmentState::DBusActivation,
+                    dbusActivationEnv);
 
     // _user_ systemd env
     QDBusMessage systemdActivationMsg = QDBusMessage::createMethodCall(QStringLiteral("org.freedesktop.systemd1"),
@@ -115,7 +132,15 @@ void KUpdateLaunchEnvironmentJob::start()
     systemdActivationMsg.setArguments({systemdUpdates});
 
     auto systemdActivationReply = QDBusConnection::sessionBus().asyncCall(systemdActivationMsg);
-    d->monitorReply(systemdActivationReply);
+    d->monitorReply(systemdActivationReply,
+                    QStringLiteral("org.freedesktop.systemd1.Manager.SetEnvironment"),
+                    KLaunchEnvironmentState::Systemd,
+                    systemdEnv);
+}
+
+KLaunchEnvironmentState::Backends KUpdateLaunchEnvironmentJob::acknowledgedBackends() const
+{
+    return KLaunchEnvironmentState::AllBackends & ~d->failedBackends;
 }
 
 bool KUpdateLaunchEnvironmentJobPrivate::isPosixName(const QString &name)
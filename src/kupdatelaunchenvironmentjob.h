@@ -9,6 +9,7 @@
 #define KUPDATELAUNCHENVIRONMENTJOB_H
 
 #include <kdbusaddons_export.h>
+#include <klaunchenvironmentstate.h>
 
 #include <QProcessEnvironment>
 
@@ -35,6 +36,11 @@ class KUpdateLaunchEnvironmentJobPrivate;
  *
  * This object deletes itself after completion, similar to KJobs.
  *
+ * The variables each backend acknowledged are recorded in KLaunchEnvironmentState.
+ *
+ * Like KDBusService, the job writes the duration of each backend call to the
+ * trace file named by \c KDBUSADDONS_TRACE_FILE.
+ *
  * Example usage:
  *
  * \code
@@ -61,6 +67,15 @@ public:
     explicit KUpdateLaunchEnvironmentJob(const QProcessEnvironment &environment);
     ~KUpdateLaunchEnvironmentJob() override;
 
+    /*!
+     * Returns the backends that acknowledged all variables they were sent.
+     *
+     * Only meaningful once finished() was emitted.
+     *
+     * \since 6.28
+     */
+    KLaunchEnvironmentState::Backends acknowledgedBackends() const;
+
 Q_SIGNALS:
     /*!
      * Emitted when the job is finished, before the object is automatically deleted.
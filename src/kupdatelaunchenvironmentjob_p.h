@@ -0,0 +1,39 @@
+/*
+    SPDX-FileCopyrightText: 2020 Kai Uwe Broulik <kde@broulik.de>
+    SPDX-FileCopyrightText: 2021 David Edmundson <davidedmundson@kde.org>
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#ifndef KUPDATELAUNCHENVIRONMENTJOB_P_H
+#define KUPDATELAUNCHENVIRONMENTJOB_P_H
+
+#include "klaunchenvironmentstate.h"
+
+#include <QDBusPendingReply>
+#include <QMap>
+#include <QProcessEnvironment>
+
+class KUpdateLaunchEnvironmentJob;
+
+class KUpdateLaunchEnvironmentJobPrivate
+{
+public:
+    explicit KUpdateLaunchEnvironmentJobPrivate(KUpdateLaunchEnvironmentJob *q);
+    void monitorReply(const QDBusPendingReply<> &reply,
+                      const QString &traceName,
+                      KLaunchEnvironmentState::Backend backend,
+                      const QMap<QString, QString> &variables);
+
+    // Variables failing these checks are never synced, KLaunchEnvironmentState does not expect them
+    static bool isPosixName(const QString &name);
+    static bool isSystemdApprovedValue(const QString &value);
+
+    KUpdateLaunchEnvironmentJob *q;
+    QProcessEnvironment environment;
+    int pendingReplies = 0;
+    KLaunchEnvironmentState::Backends failedBackends;
+    qint64 traceBegin = 0;
+};
+
+#endif
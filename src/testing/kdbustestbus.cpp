@@ -0,0 +1,391 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#include "kdbustestbus.h"
+
+#include <QCoreApplication>
+#include <QDBusContext>
+#include <QDBusError>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QTimer>
+
+#include <algorithm>
+#include <vector>
+
+#include <sys/resource.h>
+
+class KDBusTestBusPrivate
+{
+public:
+    QProcess daemon;
+    QTemporaryFile daemonConfig;
+    QProcess monitor;
+    QString address;
+    QStringList connectionNames;
+    QByteArray monitorBuffer;
+    qint64 messageCount = -1;
+    KDBusTestBus::Stubs failingStubs;
+    QMap<QString, QString> startupEnvironment;
+    QStringList systemdEnvironment;
+
+    static int s_serial;
+    const int serial = ++s_serial;
+};
+
+int KDBusTestBusPrivate::s_serial = 0;
+
+// Stands in for plasma-session
+class StartupStubObject : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.Startup")
+public:
+    StartupStubObject(KDBusTestBusPrivate *d, QObject *parent)
+        : QObject(parent)
+        , d(d)
+    {
+    }
+
+public Q_SLOTS:
+    void updateLaunchEnv(const QString &name, const QString &value)
+    {
+        if (d->failingStubs & KDBusTestBus::StartupStub) {
+            sendErrorReply(QDBusError::Failed, QStringLiteral("Failing on request of the test"));
+            return;
+        }
+        d->startupEnvironment.insert(name, value);
+    }
+
+private:
+    KDBusTestBusPrivate *const d;
+};
+
+// Stands in for the manager of the systemd user instance
+class SystemdStubObject : public QObject, protected QDBusContext
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.systemd1.Manager")
+public:
+    SystemdStubObject(KDBusTestBusPrivate *d, QObject *parent)
+        : QObject(parent)
+        , d(d)
+    {
+    }
+
+public Q_SLOTS:
+    void SetEnvironment(const QStringList &assignments)
+    {
+        if (d->failingStubs & KDBusTestBus::SystemdStub) {
+            sendErrorReply(QDBusError::Failed, QStringLiteral("Failing on request of the test"));
+            return;
+        }
+        // Like systemd, a new assignment replaces an earlier one of the same variable
+        for (const QString &assignment : assignments) {
+            const QString name = assignment.section(QLatin1Char('='), 0, 0) + QLatin1Char('=');
+            d->systemdEnvironment.removeIf([&name](const QString &existing) {
+                return existing.startsWith(name);
+            });
+            d->systemdEnvironment.append(assignment);
+        }
+    }
+
+private:
+    KDBusTestBusPrivate *const d;
+};
+
+KDBusTestBus::KDBusTestBus(QObject *parent)
+    : QObject(parent)
+    , d(new KDBusTestBusPrivate)
+{
+}
+
+KDBusTestBus::~KDBusTestBus()
+{
+    for (const QString &name : std::as_const(d->connectionNames)) {
+        QDBusConnection::disconnectFromBus(name);
+    }
+    if (d->monitor.state() != QProcess::NotRunning) {
+        d->monitor.kill();
+        d->monitor.waitForFinished();
+    }
+    if (d->daemon.state() != QProcess::NotRunning) {
+        d->daemon.terminate();
+        d->daemon.waitForFinished();
+    }
+}
+
+bool KDBusTestBus::start(Stubs stubs)
+{
+    const QString daemon = QStandardPaths::findExecutable(QStringLiteral("dbus-daemon"));
+    if (daemon.isEmpty()) {
+        qWarning() << "dbus-daemon not found";
+        return false;
+    }
+
+    // The session configuration of the system would let the bus activate the installed services
+    if (!d->daemonConfig.open()) {
+        qWarning() << "Failed to write the dbus-daemon configuration:" << d->daemonConfig.errorString();
+        return false;
+    }
+    d->daemonConfig.write(QStringLiteral("<!DOCTYPE busconfig PUBLIC \"-//freedesktop//DTD D-Bus Bus Configuration 1.0//EN\"\n"
+                                         " \"http://www.freedesktop.org/standards/dbus/1.0/busconfig.dtd\">\n"
+                                         "<busconfig>\n"
+                                         "  <type>session</type>\n"
+                                         "  <listen>unix:tmpdir=%1</listen>\n"
+                                         "  <policy context=\"default\">\n"
+                                         "    <allow send_destination=\"*\" eavesdrop=\"true\"/>\n"
+                                         "    <allow eavesdrop=\"true\"/>\n"
+                                         "    <allow own=\"*\"/>\n"
+                                         "  </policy>\n"
+                                         "</busconfig>\n")
+                              .arg(QDir::tempPath().toHtmlEscaped())
+                              .toUtf8());
+    d->daemonConfig.close();
+
+    d->daemon.setProgram(daemon);
+    d->daemon.setArguments({QStringLiteral("--config-file=") + d->daemonConfig.fileName(), QStringLiteral("--nofork"), QStringLiteral("--print-address")});
+    d->daemon.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    d->daemon.start();
+    if (!d->daemon.waitForStarted() || !d->daemon.waitForReadyRead()) {
+        qWarning() << "Failed to start dbus-daemon:" << d->daemon.errorString();
+        return false;
+    }
+
+    d->address = QString::fromLocal8Bit(d->daemon.readLine()).trimmed();
+    if (d->address.isEmpty()) {
+        qWarning() << "dbus-daemon did not print its address";
+        return false;
+    }
+
+    if (stubs) {
+        QDBusConnection connection = this->connection(QStringLiteral("stubs"));
+        if (stubs & StartupStub) {
+            if (!connection.registerObject(QStringLiteral("/Startup"), new StartupStubObject(d.get(), this), QDBusConnection::ExportAllSlots)
+                || !connection.registerService(QStringLiteral("org.kde.Startup"))) {
+                qWarning() << "Failed to register the org.kde.Startup stub:" << connection.lastError().message();
+                return false;
+            }
+        }
+        if (stubs & SystemdStub) {
+            if (!connection.registerObject(QStringLiteral("/org/freedesktop/systemd1"), new SystemdStubObject(d.get(), this), QDBusConnection::ExportAllSlots)
+                || !connection.registerService(QStringLiteral("org.freedesktop.systemd1"))) {
+                qWarning() << "Failed to register the org.freedesktop.systemd1 stub:" << connection.lastError().message();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool KDBusTestBus::isRunning() const
+{
+    return d->daemon.state() == QProcess::Running;
+}
+
+QString KDBusTestBus::address() const
+{
+    return d->address;
+}
+
+QDBusConnection KDBusTestBus::connection(const QString &name)
+{
+    // Several test buses may exist at the same time, keep their connections apart
+    const QString connectionName = QStringLiteral("kdbustestbus-%1-%2").arg(d->serial).arg(name);
+    if (!d->connectionNames.contains(connectionName)) {
+        d->connectionNames.append(connectionName);
+    }
+    return QDBusConnection::connectToBus(d->address, connectionName);
+}
+
+QProcessEnvironment KDBusTestBus::processEnvironment() const
+{
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert(QStringLiteral("DBUS_SESSION_BUS_ADDRESS"), d->address);
+    return environment;
+}
+
+void KDBusTestBus::exportAsSessionBus()
+{
+    qputenv("DBUS_SESSION_BUS_ADDRESS", d->address.toLocal8Bit());
+}
+
+void KDBusTestBus::setFailingStubs(Stubs stubs)
+{
+    d->failingStubs = stubs;
+}
+
+QMap<QString, QString> KDBusTestBus::startupEnvironment() const
+{
+    return d->startupEnvironment;
+}
+
+QStringList KDBusTestBus::systemdEnvironment() const
+{
+    return d->systemdEnvironment;
+}
+
+bool KDBusTestBus::startMessageCounting()
+{
+    const QString monitor = QStandardPaths::findExecutable(QStringLiteral("dbus-monitor"));
+    if (monitor.isEmpty()) {
+        qWarning() << "dbus-monitor not found";
+        return false;
+    }
+
+    // The profile format prints one line per message, after a header line starting with #
+    QObject::connect(&d->monitor, &QProcess::readyReadStandardOutput, this, [this]() {
+        d->monitorBuffer += d->monitor.readAllStandardOutput();
+        qsizetype start = 0;
+        for (qsizetype end = d->monitorBuffer.indexOf('\n'); end != -1; end = d->monitorBuffer.indexOf('\n', start)) {
+            if (end > start && d->monitorBuffer.at(start) != '#') {
+                ++d->messageCount;
+            }
+            start = end + 1;
+        }
+        d->monitorBuffer.remove(0, start);
+    });
+
+    d->monitor.setProgram(monitor);
+    d->monitor.setArguments({QStringLiteral("--address"), d->address, QStringLiteral("--profile")});
+    d->monitor.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    d->monitor.start();
+    if (!d->monitor.waitForStarted() || !d->monitor.waitForReadyRead()) {
+        qWarning() << "Failed to start dbus-monitor:" << d->monitor.errorString();
+        return false;
+    }
+
+    d->messageCount = 0;
+    return true;
+}
+
+qint64 KDBusTestBus::messageCount() const
+{
+    return d->messageCount;
+}
+
+QList<KDBusTestBus::LaunchResult> KDBusTestBus::launchStorm(const QString &program, const QStringList &arguments, int count, int timeout)
+{
+    QList<LaunchResult> results(count);
+    std::vector<std::unique_ptr<QProcess>> processes;
+    processes.reserve(count);
+    const QProcessEnvironment environment = processEnvironment();
+
+    QEventLoop loop;
+    int running = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < count; ++i) {
+        auto *process = processes.emplace_back(std::make_unique<QProcess>()).get();
+        process->setProgram(program);
+        process->setArguments(arguments);
+        process->setProcessEnvironment(environment);
+        process->setStandardOutputFile(QProcess::nullDevice());
+
+        const qint64 startedAt = timer.nsecsElapsed();
+        const auto done = [&, i, startedAt]() {
+            results[i].elapsed = timer.nsecsElapsed() - startedAt;
+            if (--running == 0) {
+                loop.quit();
+            }
+        };
+
+        // Drain the pipe continuously so that no process blocks on a full one
+        QObject::connect(process, &QProcess::readyReadStandardError, &loop, [&results, process, i]() {
+            results[i].standardError += process->readAllStandardError();
+        });
+        QObject::connect(process, &QProcess::finished, &loop, [&results, process, i, done](int exitCode, QProcess::ExitStatus exitStatus) {
+            results[i].exitCode = exitCode;
+            results[i].crashed = exitStatus == QProcess::CrashExit;
+            results[i].standardError += process->readAllStandardError();
+            done();
+        });
+        QObject::connect(process, &QProcess::errorOccurred, &loop, [&results, i, done](QProcess::ProcessError error) {
+            if (error == QProcess::FailedToStart) {
+                results[i].crashed = true;
+                done();
+            }
+        });
+
+        ++running;
+        process->start();
+    }
+
+    if (running > 0) {
+        QTimer::singleShot(timeout, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+
+    for (int i = 0; i < count; ++i) {
+        QProcess *process = processes[i].get();
+        if (process->state() != QProcess::NotRunning) {
+            process->kill();
+            process->waitForFinished();
+            results[i].timedOut = true;
+        }
+    }
+
+    return results;
+}
+
+qint64 KDBusTestBus::peakChildMemory()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_CHILDREN, &usage) != 0) {
+        return -1;
+    }
+#ifdef Q_OS_MACOS
+    // Reported in bytes instead of kilobytes
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+QList<qint64> KDBusTestBus::measureLatency(const QDBusConnection &connection, const QDBusMessage &message, int iterations)
+{
+    QList<qint64> latencies;
+    latencies.reserve(iterations);
+
+    QElapsedTimer timer;
+    for (int i = 0; i < iterations; ++i) {
+        timer.start();
+        const QDBusMessage reply = connection.call(message, QDBus::BlockWithGui);
+        latencies.append(timer.nsecsElapsed());
+        if (reply.type() == QDBusMessage::ErrorMessage) {
+            qWarning() << "Call failed while measuring latency:" << reply.errorName() << reply.errorMessage();
+        }
+    }
+
+    return latencies;
+}
+
+KDBusTestBus::LatencyStatistics KDBusTestBus::latencyStatistics(QList<qint64> samples)
+{
+    LatencyStatistics statistics;
+    statistics.count = samples.size();
+    if (samples.isEmpty()) {
+        return statistics;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    statistics.p50 = samples.at((samples.size() - 1) / 2);
+    statistics.p99 = samples.at((samples.size() - 1) * 99 / 100);
+    statistics.max = samples.constLast();
+    return statistics;
+}
+
+#include "kdbustestbus.moc"
+#include "moc_kdbustestbus.cpp"
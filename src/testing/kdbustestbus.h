@@ -0,0 +1,242 @@
+/*
+    This file is part of libkdbusaddons
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.1-only OR LGPL-3.0-only OR LicenseRef-KDE-Accepted-LGPL
+*/
+
+#ifndef KDBUSTESTBUS_H
+#define KDBUSTESTBUS_H
+
+#include <kdbusaddonstesting_export.h>
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QObject>
+#include <QProcessEnvironment>
+
+#include <memory>
+
+class KDBusTestBusPrivate;
+
+/*!
+ * \class KDBusTestBus
+ * \inmodule KDBusAddons
+ *
+ * \brief An isolated dbus-daemon for tests and benchmarks.
+ *
+ * KDBusTestBus starts a private session bus that only the test and the
+ * processes it launches can see, so that tests of D-Bus services do not depend
+ * on, nor disturb, the session bus of the machine they run on.
+ *
+ * On request it also provides stubs of the services that the session startup
+ * talks to, \c org.kde.Startup and \c org.freedesktop.systemd1, which record
+ * the launch environment they receive.
+ *
+ * The helpers launchStorm() and measureLatency() allow to measure how a
+ * service behaves under load in a repeatable way:
+ *
+ * \code
+ * KDBusTestBus bus;
+ * QVERIFY(bus.start(KDBusTestBus::AllStubs));
+ *
+ * QDBusConnection connection = bus.connection(QStringLiteral("client"));
+ * const QList<qint64> latencies = bus.measureLatency(connection, message, 1000);
+ * qDebug() << KDBusTestBus::latencyStatistics(latencies).p99;
+ * \endcode
+ *
+ * The dbus-daemon is terminated when the object is destroyed.
+ *
+ * This class is only available on Unix, in the \c KF6::DBusAddonsTesting
+ * library.
+ *
+ * \since 6.28
+ */
+class KDBUSADDONSTESTING_EXPORT KDBusTestBus : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * The stub services that can be provided on the bus.
+     *
+     * \value NoStubs No stubs are registered
+     * \value StartupStub Registers \c org.kde.Startup with the \c updateLaunchEnv method
+     * \value SystemdStub Registers \c org.freedesktop.systemd1 with the \c SetEnvironment method of the manager
+     * \value AllStubs All stubs are registered
+     */
+    enum Stub {
+        NoStubs = 0,
+        StartupStub = 1,
+        SystemdStub = 2,
+        AllStubs = StartupStub | SystemdStub,
+    };
+    Q_ENUM(Stub)
+    Q_DECLARE_FLAGS(Stubs, Stub)
+    Q_FLAG(Stubs)
+
+    /*!
+     * The outcome of one process started by launchStorm().
+     */
+    struct LaunchResult {
+        /*! The exit code of the process. */
+        int exitCode = -1;
+        /*! Whether the process exited normally or crashed. */
+        bool crashed = false;
+        /*! Whether the process was killed because it did not exit in time. */
+        bool timedOut = false;
+        /*! The time from starting the process until it exited, in nanoseconds. */
+        qint64 elapsed = 0;
+        /*! Everything the process wrote to its standard error. */
+        QByteArray standardError;
+    };
+
+    /*!
+     * A summary of latency samples, in the unit of the samples.
+     */
+    struct LatencyStatistics {
+        /*! The number of samples. */
+        int count = 0;
+        /*! The median. */
+        qint64 p50 = 0;
+        /*! The 99th percentile. */
+        qint64 p99 = 0;
+        /*! The largest sample. */
+        qint64 max = 0;
+    };
+
+    /*!
+     * Creates a test bus with the given \a parent.
+     *
+     * The bus is not started until start() is called.
+     */
+    explicit KDBusTestBus(QObject *parent = nullptr);
+
+    /*!
+     * Disconnects all connections created by connection() and terminates the dbus-daemon.
+     */
+    ~KDBusTestBus() override;
+
+    /*!
+     * Starts the dbus-daemon and registers the given \a stubs on it.
+     *
+     * The daemon knows no service files, so no service of the machine can be
+     * activated on the test bus.
+     *
+     * Returns \c false if no dbus-daemon is installed, if it failed to start
+     * or if a stub could not be registered, in which case tests usually want
+     * to skip.
+     */
+    bool start(Stubs stubs = NoStubs);
+
+    /*!
+     * Returns whether the dbus-daemon is running.
+     */
+    bool isRunning() const;
+
+    /*!
+     * Returns the address of the bus, to be used with QDBusConnection::connectToBus().
+     */
+    QString address() const;
+
+    /*!
+     * Returns the connection to the bus called \a name, creating it if needed.
+     *
+     * Every connection gets its own unique name on the bus, so a test can
+     * behave like several independent processes. The connection is closed
+     * when the test bus is destroyed.
+     */
+    QDBusConnection connection(const QString &name);
+
+    /*!
+     * Returns the system environment with \c DBUS_SESSION_BUS_ADDRESS pointing
+     * to this bus, for processes that should run against it.
+     */
+    QProcessEnvironment processEnvironment() const;
+
+    /*!
+     * Makes this bus the session bus of the current process.
+     *
+     * This only takes effect when called before the first use of
+     * QDBusConnection::sessionBus(), typically in \c initTestCase(), and is
+     * meant for code that always uses the session bus, such as
+     * KUpdateLaunchEnvironmentJob.
+     */
+    void exportAsSessionBus();
+
+    /*!
+     * Makes the given \a stubs reply to all calls with an error, to test how
+     * failing backends are handled.
+     */
+    void setFailingStubs(Stubs stubs);
+
+    /*!
+     * Returns the variables the \c org.kde.Startup stub received.
+     */
+    QMap<QString, QString> startupEnvironment() const;
+
+    /*!
+     * Returns the assignments of the form \c NAME=value the
+     * \c org.freedesktop.systemd1 stub received.
+     */
+    QStringList systemdEnvironment() const;
+
+    /*!
+     * Starts counting all messages passing the bus.
+     *
+     * This runs \c dbus-monitor on the bus and returns \c false if it is not
+     * installed.
+     *
+     * \sa messageCount()
+     */
+    bool startMessageCounting();
+
+    /*!
+     * Returns the number of messages that passed the bus since
+     * startMessageCounting() was called, or \c -1 if the messages are not
+     * being counted.
+     *
+     * Messages are counted as the event loop runs, so the count may lag
+     * slightly behind.
+     */
+    qint64 messageCount() const;
+
+    /*!
+     * Starts \a count instances of \a program with \a arguments at the same
+     * time against this bus and waits for all of them to exit.
+     *
+     * Processes that did not exit within \a timeout milliseconds are killed
+     * and reported as timed out. The results are in the order the processes
+     * were started.
+     */
+    QList<LaunchResult> launchStorm(const QString &program, const QStringList &arguments, int count, int timeout = 30000);
+
+    /*!
+     * Returns the largest resident set size of any child process of the
+     * current process that exited so far, such as those started by
+     * launchStorm(), in kilobytes.
+     */
+    static qint64 peakChildMemory();
+
+    /*!
+     * Sends \a message over \a connection \a iterations times and returns the
+     * round-trip time of each call in nanoseconds.
+     *
+     * The calls are made with QDBus::BlockWithGui, so services living in the
+     * calling thread can reply.
+     */
+    static QList<qint64> measureLatency(const QDBusConnection &connection, const QDBusMessage &message, int iterations);
+
+    /*!
+     * Summarizes the given latency \a samples.
+     */
+    static LatencyStatistics latencyStatistics(QList<qint64> samples);
+
+private:
+    std::unique_ptr<KDBusTestBusPrivate> const d;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(KDBusTestBus::Stubs)
+
+#endif
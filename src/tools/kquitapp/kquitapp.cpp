@@ -6,8 +6,59 @@
 
 #include <QCommandLineParser>
 #include <QCoreApplication>
-#include <QDBusInterface>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QRegularExpression>
+#include <QSet>
+#include <QTextStream>
+
+#include <kquitservicejob.h>
+
+#include <algorithm>
+
+static bool isPattern(const QString &service)
+{
+    return service.contains(QLatin1Char('*')) || service.contains(QLatin1Char('?')) || service.contains(QLatin1Char('['));
+}
+
+// Resolves name globs against the names currently on the bus, with a single ListNames round-trip
+static QStringList expandPatterns(const QDBusConnection &bus, const QStringList &services, bool *ok)
+{
+    *ok = true;
+    if (std::none_of(services.cbegin(), services.cend(), isPattern)) {
+        // Every service is waited for once, however often it was given
+        QStringList unique = services;
+        unique.removeDuplicates();
+        return unique;
+    }
+
+    const QStringList registered = bus.interface()->registeredServiceNames().value();
+    QStringList expanded;
+    for (const QString &service : services) {
+        if (!isPattern(service)) {
+            expanded << service;
+            continue;
+        }
+
+        const QRegularExpression expression = QRegularExpression::fromWildcard(service, Qt::CaseSensitive);
+        bool matched = false;
+        for (const QString &name : registered) {
+            if (!name.startsWith(QLatin1Char(':')) && expression.match(name).hasMatch()) {
+                expanded << name;
+                matched = true;
+            }
+        }
+        if (!matched) {
+            qWarning() << QCoreApplication::translate("main", "No running service matches %1.").arg(service);
+            *ok = false;
+        }
+    }
+    expanded.removeDuplicates();
+    return expanded;
+}
 
 int main(int argc, char *argv[])
 {
@@ -24,34 +75,96 @@ int main(int argc, char *argv[])
                                         QCoreApplication::translate("main", "Path in the D-Bus interface to use"),
                                         QStringLiteral("path"),
                                         QStringLiteral("/MainApplication")));
-    parser.addPositionalArgument(QStringLiteral("[application]"), QCoreApplication::translate("main", "The name of the application to quit"));
+    parser.addOption(QCommandLineOption(QStringLiteral("wait"),
+                                        QCoreApplication::translate("main", "Wait until the applications have released their service names")));
+    parser.addOption(QCommandLineOption(QStringLiteral("timeout"),
+                                        QCoreApplication::translate("main", "Time in milliseconds to wait for each application"),
+                                        QStringLiteral("msecs"),
+                                        QStringLiteral("25000")));
+    parser.addPositionalArgument(QStringLiteral("[application...]"),
+                                 QCoreApplication::translate("main", "The names of the applications to quit, may contain wildcards"));
     parser.addHelpOption();
     parser.addVersionOption();
     parser.process(app);
 
-    QString service;
-    if (parser.isSet(QStringLiteral("service"))) {
-        service = parser.value(QStringLiteral("service"));
-    } else if (!parser.positionalArguments().isEmpty()) {
-        service = QStringLiteral("org.kde.%1").arg(parser.positionalArguments().at(0));
-    } else {
+    QStringList services = parser.values(QStringLiteral("service"));
+    const QStringList applications = parser.positionalArguments();
+    for (const QString &application : applications) {
+        services << QStringLiteral("org.kde.%1").arg(application);
+    }
+    if (services.isEmpty()) {
         parser.showHelp(1);
     }
 
-    QString path(parser.value(QStringLiteral("path")));
+    const QString path(parser.value(QStringLiteral("path")));
+    const bool wait = parser.isSet(QStringLiteral("wait"));
+    bool timeoutValid = false;
+    const int timeout = parser.value(QStringLiteral("timeout")).toInt(&timeoutValid);
+    if (!timeoutValid || timeout < 0) {
+        qWarning() << QCoreApplication::translate("main", "Invalid timeout %1, expected a number of milliseconds.").arg(parser.value(QStringLiteral("timeout")));
+        return 1;
+    }
 
-    QDBusInterface interface(service, path);
-    if (!interface.isValid()) {
-        qWarning() << QCoreApplication::translate("main", "Application %1 could not be found using service %2 and path %3.")
-                          .arg(parser.positionalArguments().at(0), service, path);
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (!bus.isConnected() || !bus.interface()) {
+        qWarning() << QCoreApplication::translate("main", "Could not connect to the D-Bus session bus.");
         return 1;
     }
-    interface.call(QStringLiteral("quit"));
-    QDBusError error = interface.lastError();
-    if (error.type() != QDBusError::NoError) {
-        qWarning() << QCoreApplication::translate("main", "Quitting application %1 failed. Error reported was:\n\n     %2 : %3")
-                          .arg(parser.positionalArguments().join(QStringLiteral(" ")), error.name(), error.message());
+
+    bool allMatched = true;
+    services = expandPatterns(bus, services, &allMatched);
+    if (services.isEmpty()) {
         return 1;
     }
-    return 0;
+
+    QTextStream out(stdout);
+    QHash<QString, QElapsedTimer> timers;
+    QSet<QString> done;
+    int failures = allMatched ? 0 : 1;
+
+    auto finish = [&](const QString &service, const QString &error) {
+        if (done.contains(service)) {
+            return;
+        }
+        done.insert(service);
+
+        const qint64 elapsed = timers.value(service).elapsed();
+        if (error.isEmpty()) {
+            out << QCoreApplication::translate("main", "%1: quit (%2 ms)").arg(service).arg(elapsed) << Qt::endl;
+        } else {
+            ++failures;
+            out << QCoreApplication::translate("main", "%1: failed (%2 ms)").arg(service).arg(elapsed) << Qt::endl;
+            qWarning().noquote() << error;
+        }
+
+        if (done.size() == services.size()) {
+            app.exit(failures ? 1 : 0);
+        }
+    };
+
+    // Every application is asked to quit at the same time
+    for (const QString &service : std::as_const(services)) {
+        timers[service].start();
+
+        auto *job = new KQuitServiceJob(service, &app);
+        job->setObjectPath(path);
+        job->setWaitForRelease(wait);
+        job->setTimeout(timeout);
+        QObject::connect(job, &KQuitServiceJob::finished, &app, [&, job]() {
+            const QDBusError error = job->error();
+            const QString service = job->serviceName();
+            if (!error.isValid()) {
+                finish(service, QString());
+            } else if (error.type() == QDBusError::ServiceUnknown || error.type() == QDBusError::UnknownObject) {
+                finish(service,
+                       QCoreApplication::translate("main", "Application %1 could not be found using service %2 and path %3.").arg(service, service, path));
+            } else {
+                finish(service,
+                       QCoreApplication::translate("main", "Quitting application %1 failed. Error reported was:\n\n     %2 : %3")
+                           .arg(service, error.name(), error.message()));
+            }
+        });
+    }
+
+    return app.exec();
 }
@@ -0,0 +1,85 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+
+#include <kdbustestbus.h>
+
+#include <algorithm>
+
+// Starts many instances of a Unique application at the same time on a private bus, like
+// a desktop-wide "open all" does, and checks that exactly one of them stays primary.
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption instancesOption(QStringLiteral("instances"), QStringLiteral("Number of instances to start at once."), QStringLiteral("count"), QStringLiteral("200"));
+    QCommandLineOption timeoutOption(QStringLiteral("timeout"), QStringLiteral("Time to wait for all instances to exit, in ms."), QStringLiteral("ms"), QStringLiteral("60000"));
+    parser.addOption(instancesOption);
+    parser.addOption(timeoutOption);
+    parser.process(app);
+
+    const int instances = std::max(parser.value(instancesOption).toInt(), 1);
+    const int timeout = parser.value(timeoutOption).toInt();
+
+    KDBusTestBus bus;
+    if (!bus.start()) {
+        qCritical() << "Could not start a private dbus-daemon";
+        return 125;
+    }
+    const bool countingMessages = bus.startMessageCounting();
+
+    const QString program = QCoreApplication::applicationDirPath() + QStringLiteral("/kdbusstormservice");
+    const QList<KDBusTestBus::LaunchResult> results = bus.launchStorm(program, {QString::number(instances - 1)}, instances, timeout);
+
+    int primaries = 0;
+    int forwarded = 0;
+    int failed = 0;
+    int timedOut = 0;
+    int unregistered = 0;
+    QList<qint64> exitTimes;
+    for (const KDBusTestBus::LaunchResult &result : results) {
+        exitTimes.append(result.elapsed);
+
+        if (result.timedOut) {
+            ++timedOut;
+        } else if (!result.crashed && result.exitCode == 3) {
+            // Neither forwarded nor got the name, see kdbusstormservice
+            ++unregistered;
+            ++failed;
+        } else if (result.crashed || result.exitCode != 0) {
+            ++failed;
+        } else if (!result.standardError.contains("kdbusstormservice: primary")) {
+            ++forwarded;
+        }
+        if (result.standardError.contains("kdbusstormservice: primary")) {
+            ++primaries;
+        }
+    }
+
+    const KDBusTestBus::LatencyStatistics statistics = KDBusTestBus::latencyStatistics(exitTimes);
+
+    qInfo().noquote() << "Instances:" << instances;
+    qInfo().noquote() << "Primary:" << primaries << "forwarded:" << forwarded << "failed:" << failed << "timed out:" << timedOut;
+    qInfo().noquote() << "Time to exit (ms): p50" << statistics.p50 / 1000000.0 << "p99" << statistics.p99 / 1000000.0 << "max" << statistics.max / 1000000.0;
+    qInfo().noquote() << "Peak memory of an instance (kB):" << KDBusTestBus::peakChildMemory();
+    if (countingMessages) {
+        qInfo().noquote() << "Bus messages:" << bus.messageCount();
+    }
+    qInfo().noquote() << "Failed to register:" << unregistered;
+
+    if (primaries != 1 || forwarded != instances - 1) {
+        qCritical() << "Expected exactly one primary instance and all others to forward";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+    This file is part of libkdbus
+
+    SPDX-FileCopyrightText: 2026 KDE Contributors
+
+    SPDX-License-Identifier: LGPL-2.0-or-later
+*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+
+#include <kdbusservice.h>
+
+// Application launched many times at once by kdbusservicestormtest.
+// The first argument is the number of other instances expected to forward to the primary one.
+// An instance that neither forwarded nor got the name exits with 3.
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("kdbusstormservice"));
+    QCoreApplication::setOrganizationDomain(QStringLiteral("kde.org"));
+
+    const int expected = app.arguments().value(1).toInt();
+
+    // All instances but the primary one forward their arguments and exit in here
+    KDBusService service(KDBusService::Unique | KDBusService::NoExitOnFailure);
+    if (!service.isRegistered()) {
+        qWarning() << "kdbusstormservice: not registered:" << service.errorMessage();
+        return 3;
+    }
+    qInfo() << "kdbusstormservice: primary";
+
+    if (expected <= 0) {
+        return 0;
+    }
+
+    // Give up when the forwarding stops, so that a stuck storm does not keep the name forever
+    QTimer idleTimer;
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(10000);
+    QObject::connect(&idleTimer, &QTimer::timeout, &app, []() {
+        qWarning() << "kdbusstormservice: not all instances forwarded";
+        QCoreApplication::exit(2);
+    });
+
+    int activations = 0;
+    QObject::connect(&service, &KDBusService::activateRequested, &app, [&]() {
+        if (++activations == expected) {
+            QCoreApplication::quit();
+        } else {
+            idleTimer.start();
+        }
+    });
+
+    idleTimer.start();
+    return app.exec();
+}